@@ -25,11 +25,68 @@ extern "C" {
 // SDK Libraries
 #include "pico/stdlib.h"
 #include "hardware/i2c.h"
+#include "hardware/dma.h"
+#include "hardware/irq.h"
 
 
 #define device_address 0x36
 #define raw_angle_address 0x0E
 
+#define AS5600_BUS_MAX_ENCODERS 2
+#define AS5600_BUS_NO_ENCODER -1
+
+#define AS5600_ASYNC_TIMEOUT_US 2000    // Stale transfer is aborted after it
+#define AS5600_DMA_IRQ DMA_IRQ_0
+
+/* Encoder bus ---------------------------------------------------------------*/
+
+/**
+ * @brief Every AS5600 answers on the fixed address 0x36, so several encoders
+ * share one I2C controller by routing only the selected encoder pins to it.
+ * The controller is initialized once and a read only switches the pin mux
+ * when the encoder changes.
+ */
+
+typedef struct{
+    uint32_t sda_pin;
+    uint32_t scl_pin;
+}AS5600_Pins;
+
+/**
+ * @brief Asynchronous read completion, executed in interrupt context.
+ *
+ * @param context User context given to AS5600_Bus_dma_init
+ * @param encoder Encoder that was read
+ * @param angle Raw angle register value, 0 if the read failed
+ * @param ok false if the transfer was aborted (NACK, missing encoder)
+ */
+typedef void (*AS5600_Callback)(void* context, uint8_t encoder, uint16_t angle,
+                                bool ok);
+
+typedef struct{
+    i2c_inst_t* i2c;
+    AS5600_Pins encoders[AS5600_BUS_MAX_ENCODERS];
+    uint8_t num_encoders;
+    int8_t selected;                    // Encoder routed to the controller
+
+    // Asynchronous reads
+    int tx_dma;
+    int rx_dma;
+    uint16_t tx_cmds[3];                // Register address + 2 read commands
+    uint8_t rx_data[2];
+    volatile bool busy;
+    uint8_t pending_encoder;
+    uint32_t start_us;
+    uint32_t timeouts;                  // Stale transfers aborted
+    uint32_t aborts;                    // Transfers aborted by the controller
+    AS5600_Callback callback;
+    void* context;
+
+    // Read benchmark
+    uint32_t last_read_us;              // Duration of the last read
+    uint32_t max_read_us;               // Worst read duration
+}AS5600_Bus;
+
 static void read_register(i2c_inst_t* i2c_instance, 
                    uint8_t device_addr,
                    uint8_t register_address,
@@ -44,8 +101,18 @@ void AS5600_config_pull_up(uint32_t sda_pin, uint32_t scl_pin);
 void AS5600_config_pins(uint32_t sda_pin, uint32_t scl_pin);
 void AS5600_free_pins(uint32_t sda_pin, uint32_t scl_pin);
 
+void AS5600_Bus_ctor(AS5600_Bus* this, i2c_inst_t* i2c, uint32_t baudrate);
+uint8_t AS5600_Bus_add(AS5600_Bus* this, uint32_t sda_pin, uint32_t scl_pin);
+void AS5600_Bus_select(AS5600_Bus* this, uint8_t encoder);
+uint16_t AS5600_Bus_read_angle(AS5600_Bus* this, uint8_t encoder);
+
+void AS5600_Bus_dma_init(AS5600_Bus* this, AS5600_Callback callback,
+                         void* context);
+bool AS5600_Bus_read_angle_async(AS5600_Bus* this, uint8_t encoder);
+void AS5600_Bus_abort(AS5600_Bus* this);
+
 #ifdef __cplusplus
 }
 #endif
 
-#endif // _DEV_HD44780_H_
\ No newline at end of file
+#endif // AS5600_H
\ No newline at end of file
@@ -31,78 +31,78 @@ extern "C" {
 #include <FreeAct.h>
 
 // Project libraries
+#include "axis_config.h"
 #include "pio_stepper.h"
 #include "AS5600.h"
+#include "calib_flash.h"
+#include "fixed_point.h"
+#include "motion_plan.h"
+#include "motion_profile.h"
+#include "motors_snapshot.h"
 
 /* External AO calls --- -----------------------------------------------------*/
 
 extern Active *AO_blinkyButton;
 
-/* Constants definitions -----------------------------------------------------*/
-
-#define MOTOR1_STEP_PIN 2
-#define MOTOR1_DIR_PIN 3
-#define MOTOR1_ENABLE_PIN 4
-
-#define MOTOR2_STEP_PIN 5
-#define MOTOR2_DIR_PIN 6
-#define MOTOR2_ENABLE_PIN 7
-
-#define ENCODER1_SDA_PIN 10
-#define ENCODER1_SCL_PIN 11
-
-#define ENCODER2_SDA_PIN 14
-#define ENCODER2_SCL_PIN 15
-
-#define END_SWITCH_1 8
-#define END_SWITCH_2 9
+// Published after every event, read with Motors_snapshot_read()
+extern Motors_Snapshot motors_snapshot;
 
-#define MOTOR1_CALIB_FREQ 25
-#define MOTOR1_CALIB_STEPS 1
-
-#define MOTOR2_CALIB_FREQ 25
-#define MOTOR2_CALIB_STEPS 1
+/* Constants definitions -----------------------------------------------------*/
 
-#define MOTOR1_CENTER_FREQ 25
+#define ENCODERS_I2C i2c1
+#define ENCODERS_I2C_BAUDRATE (1000 * 1000)
+
+// Homing: fast approach to the end switch, back off, slow re-approach and a
+// single streamed move to the center
+#define MOTOR1_HOMING_FAST_FREQ 300
+#define MOTOR1_HOMING_SLOW_FREQ 50
+#define MOTOR1_HOMING_BACK_OFF_STEPS 20
+#define MOTOR1_HOMING_CENTER_FREQ 200
+#define MOTOR1_HOMING_MAX_STEPS (2*MOTOR1_FULL_RANGE_STEPS)
+
+#define MOTOR2_HOMING_FAST_FREQ 150
+#define MOTOR2_HOMING_SLOW_FREQ 25
+#define MOTOR2_HOMING_BACK_OFF_STEPS 8
+#define MOTOR2_HOMING_CENTER_FREQ 100
+#define MOTOR2_HOMING_MAX_STEPS (2*MOTOR2_FULL_RANGE_STEPS)
+
+#define HOMING_POLL_MS 1                // End switch polling period
+
+// Warm boot: the stored zeros are trusted when all encoders read within this
+// distance of them. An encoder only sees one motor turn, so a mechanism moved
+// by a whole turn while powered off (120° on M1, 360° on M2) is not detected.
+#define MECHANISM_ID 0x57524D01         // Change when the mechanics change
+#define FAST_BOOT_TOLERANCE 40          // Encoder counts
+#define FAST_BOOT_READ_TIMEOUT_MS 10    // A read not answered by then is lost
+#define FAST_BOOT_READ_TRIES 3          // Per encoder, then homing is required
+
+// Step by step centering is paced by the 10 ms timer, one step must fit in it
+#define MOTOR1_CENTER_FREQ 200
 #define MOTOR1_CENTER_STEPS 1
 
-#define MOTOR2_CENTER_FREQ 25
+#define MOTOR2_CENTER_FREQ 200
 #define MOTOR2_CENTER_STEPS 1
 
-#define MOTOR1_MOVEMENT_FREQ 25
-#define MOTOR1_MOVEMENT_STEPS 1
-
-#define MOTOR2_MOVEMENT_FREQ 25
-#define MOTOR2_MOVEMENT_STEPS 1
-
-
-#define MOTOR2_DEG_RANGE [-90, 90]
-#define MOTOR2_DEG_RANGE_LEN 180
-#define MOTOR2_TRANSMISSION_RATE 1
-#define MOTOR2_STEPS_PER_REV 200
-#define MOTOR2_FULL_RANGE_STEPS 100     // NUmber of steps in valid range
-#define MOTOR2_HOME_TO_CENTER_STEPS 58
-#define MOTOR2_DEG_PER_STEP (float)(360/(MOTOR2_TRANSMISSION_RATE*MOTOR2_STEPS_PER_REV))
-#define MOTOR2_STEPS_PER_DEG (float)((MOTOR2_TRANSMISSION_RATE*MOTOR2_STEPS_PER_REV)/360)
-
-
-#define MOTOR1_DEG_RANGE [-90, 110]     // End sensor at 110°
-#define MOTOR1_DEG_RANGE_LEN 100
-#define MOTOR1_TRANSMISSION_RATE 3
-#define MOTOR1_STEPS_PER_REV 200
-#define MOTOR1_FULL_RANGE_STEPS 300     // TODO Number of steps in valid range
-#define MOTOR1_HOME_TO_CENTER_STEPS 153
-#define MOTOR1_DEG_PER_STEP (float)(360/(MOTOR1_TRANSMISSION_RATE*MOTOR1_STEPS_PER_REV))
-#define MOTOR1_STEPS_PER_DEG (float)((MOTOR1_TRANSMISSION_RATE*MOTOR1_STEPS_PER_REV)/360)
-
-
-#define MOTOR1_POS_DIR  1    //(+)      // CCW positive right hand rule
-#define MOTOR1_NEG_DIR  0    //(-)
-#define ENCODER1_POS_DIR 1
-
-#define MOTOR2_POS_DIR  0   //(+)       // CCW positive right hand rule
-#define MOTOR2_NEG_DIR  1   //(-)
-#define ENCODER2_POS_DIR 0
+// Moves follow MOTION_SHAPE, the frequency is the peak step rate and caps the
+// speed requested by a move
+#define MOTION_SHAPE MOTION_SHAPE_MIN_JERK
+#define MOTOR1_MOVEMENT_FREQ 400
+#define MOTOR2_MOVEMENT_FREQ 300
+
+#define STEPPER_STEPS_PER_TURN 400
+
+// Stall detection: while moving, an encoder is read every STALL_CHECK_PERIODS
+// control periods and compared with the issued steps. Errors up to 
+// STALL_DEADBAND_STEPS are ignored, up to STALL_TOLERANCE_STEPS absorbed into
+// the position, and larger ones stop the motors. The comparison wraps at one
+// motor turn, so the tolerance must stay well below half a turn.
+#define STALL_CHECK_PERIODS 2
+#define STALL_DEADBAND_STEPS 2
+#define STALL_TOLERANCE_STEPS 8
+// A check read takes well under a control period, one still unanswered at the
+// next tick is a miss. STALL_MAX_MISSES in a row stop the motors, a stall
+// could no longer be seen.
+#define STALL_MAX_MISSES 3
 
 // Both encoders get negative numbers
 
@@ -120,11 +120,7 @@ enum Motors_Signals{
     MOTORS_AO_FREE_M1_SIG,               // Free motor 1
     MOTORS_AO_FREE_M2_SIG,               // Free motor 2
     
-    MOTORS_AO_RQ_DEG_M1_SIG, 
-    //-->UI_AO_ACK_DEG_M1_SIG
-
-    MOTORS_AO_RQ_DEG_M2_SIG,
-    //-->UI_AO_ACK_DEG_M2_SIG
+    //-->motors_snapshot measured angle
 
     MOTORS_AO_BLOCK_M1_SIG,
     MOTORS_AO_BLOCK_M2_SIG,
@@ -133,42 +129,138 @@ enum Motors_Signals{
     MOTORS_AO_MOVE_SIG,                 // Move
     //-->UI_AO_ACK_MOVE_SIG
     // Motor2
+
+    MOTORS_AO_ENCODER_READ_SIG,         // Asynchronous encoder read finished
+
+    MOTORS_AO_RUN_PLAN_SIG,             // Execute a routine motion plan
+    //-->UI_AO_PLAN_PROGRESS_SIG
+    MOTORS_AO_PAUSE_PLAN_SIG,
+    MOTORS_AO_RESUME_PLAN_SIG,          // Restarts the current repetition
+
+    MOTORS_AO_BATCH_SIG,                // Waypoints back to back
+    //-->UI_AO_PLAN_PROGRESS_SIG per waypoint (optional)
+    //-->UI_AO_ACK_MOVE_SIG once at the end
+    //-->UI_AO_NACK_MOVE_SIG if invalid, too long or the AO is busy
 };
 
 typedef struct{
     Event super;                        // Inherit from Event base class
-    enum{M1, M2}motor;
+    uint8_t encoder;                    // Bus encoder id
+    uint16_t angle;                     // Raw angle register
+    bool ok;                            // false: the read failed, no angle
+}MOTORS_AO_ENCODER_PL;
+
+typedef struct{
+    Event super;                        // Inherit from Event base class
+    Axis_Id motor;
     int16_t degrees;                    // en decimas de grado 
+    uint16_t speed;                     // Peak deg/s, 0: axis maximum
 }MOTORS_AO_MOVE_PL;
 
+typedef struct{
+    Event super;                        // Inherit from Event base class
+    Motion_Plan const* plan;            // Must stay valid until finished
+}MOTORS_AO_PLAN_PL;
+
+typedef struct{
+    Event super;                        // Inherit from Event base class
+    Motion_Waypoint const* waypoints;   // Copied when the event is handled
+    uint8_t count;
+    bool progress;                      // Report every waypoint and dwell
+}MOTORS_AO_BATCH_PL;
+
 
 typedef enum {
-    MOTORS_AO_CALIB_M1_ST,
-    MOTORS_AO_CALIB_M2_ST,
-
-    MOTORS_AO_CENTER_M1_ST,
-    MOTORS_AO_CENTER_M2_ST,
-    MOTORS_AO_CENTER_M2_FREE_FIX_ST,
+    MOTORS_AO_FAST_BOOT_ST,             // Validating the stored calibration
+    MOTORS_AO_CALIB_ST,
 
-    MOTORS_AO_FREE_M1_ST,
-    MOTORS_AO_FREE_M2_ST,
+    MOTORS_AO_CENTER_ST,                // Centering the selected axis
+    MOTORS_AO_CENTER_FIX_ST,            // Encoder fine centering
 
-    MOTORS_AO_MOVE_M1_ST,
-    MOTORS_AO_MOVE_M2_ST,
+    MOTORS_AO_FREE_ST,
+    MOTORS_AO_MOVE_ST,
+    MOTORS_AO_PLAN_ST,                  // Executing a routine motion plan
 
     MOTORS_AO_WAITING_ST
 }Motors_AO_state;
 
 typedef enum {
-    CENTER_M1_PENDING_ST,
-    CENTER_M1_DONE_ST
-}Motors_AO_Center_M1_ST_state;
+    HOMING_START_ST,
+    HOMING_FAST_APPROACH_ST,
+    HOMING_BACK_OFF_ST,
+    HOMING_SLOW_APPROACH_ST,
+    HOMING_CENTER_ST,
+    HOMING_DONE_ST,
+    HOMING_ERROR_ST                     // End switch never reached
+}Motors_AO_Homing_state;
 
 typedef enum {
-    CENTER_M2_PENDING_ST,
-    CENTER_M2_DONE_ST
-    
-}Motors_AO_Center_M2_ST_state;
+    CENTER_PENDING_ST,
+    CENTER_DONE_ST
+}Motors_AO_Center_state;
+
+/* Homing --------------------------------------------------------------------*/
+typedef struct{
+    uint32_t end_switch;                // Active low
+    bool approach_dir;                  // Direction towards the end switch
+    bool center_dir;
+    uint32_t fast_freq;
+    uint32_t slow_freq;
+    uint32_t center_freq;
+    uint16_t back_off_steps;
+    uint16_t max_steps;                 // Travel limit looking for the switch
+    uint16_t home_to_center_steps;
+}Motors_Homing_Config;
+
+typedef struct{
+    Motors_AO_Homing_state state;
+    StepperMotor* motor;
+    const Motors_Homing_Config* config;
+    uint32_t start_us;
+    uint32_t time_ms;                   // Total homing time
+    bool zeroed;                        // Encoder zero captured
+}Motors_Homing;
+
+/* Axis ----------------------------------------------------------------------*/
+typedef struct{
+    Axis_Id id;
+    char const* name;                   // For messages
+    PIO pio;
+    uint8_t sm;
+    uint32_t dir_pin;
+    uint32_t step_pin;
+    uint32_t enable_pin;
+    uint16_t transmission_rate;
+    uint16_t steps_per_rev;             // Motor shaft, no transmission
+    uint32_t encoder_sda;
+    uint32_t encoder_scl;
+    int16_t encoder_offset;
+    bool encoder_pos_dir;
+    bool pos_dir;
+    bool neg_dir;
+    bool encoder_fix;                   // Encoder fine centering after freeing
+    uint32_t center_freq;
+    uint16_t center_steps;
+    uint32_t movement_freq;             // Peak step rate
+    Motors_Homing_Config homing;
+}Motors_Axis_Config;
+
+typedef struct{
+    const Motors_Axis_Config* config;
+    StepperMotor motor;
+    Motors_Homing homing;
+    uint8_t encoder_id;
+
+    uint32_t encoder_zero;
+    int32_t encoder_current_angle;
+    int16_t encoder_turns;
+    uint16_t encoder_last_read;
+    uint32_t encoder_read_us;           // 0 before the first read
+    int32_t encoder_velocity;           // deg10/s
+
+    int32_t current_position;           // Steps from center
+    int32_t goal_position;
+}Motors_Axis;
 
 /* AO Class Data -------------------------------------------------------------*/
 typedef struct{
@@ -177,38 +269,48 @@ typedef struct{
     Motors_AO_state state;
     Motors_AO_state past_state;
 
-    // Sub SM
-    Motors_AO_Center_M1_ST_state center_m1_state; 
-    Motors_AO_Center_M2_ST_state center_m2_state; 
-
-    uint32_t encoder1_zero;
-    uint32_t encoder2_zero;
-
-    int32_t encoder1_current_angle;
-    int32_t encoder2_current_angle;
-    int16_t encoder1_turns;
-    int16_t encoder2_turns;
-    uint16_t encoder1_last_read;
-    uint16_t encoder2_last_read;
+    Motors_Axis axes[AXIS_COUNT];
+    Axis_Id axis;                       // Axis being centered, freed or moved
+    AS5600_Bus encoders;                // All encoders share one controller
 
+    // Sub SM
+    uint32_t calib_start_us;
+    Calib_Data calib;                   // Stored calibration
+    bool calib_requested;               // START_CALIB during fast boot
+    uint8_t fast_boot_reads;            // Encoders read while validating
+    uint8_t fast_boot_tries;            // Reads issued to the current encoder
+    Motors_AO_Center_state center_state;
+    bool fix_pending;                   // Fine centering read in flight
 
     uint16_t centering_steps;           // Number of steps to do centering
     bool centering_dir;
     uint16_t movement_steps;            // Number of steps to do movement
     bool movement_dir;
-
-    float motor1_current_position;
-    float motor2_current_position;
-
-    float motor1_goal_position;
-    float motor2_goal_position;
-
-
-    /* add private data (local variables) for the AO... */
-    StepperMotor motor1;
-    StepperMotor motor2;
-
-
+    Motion_Profile profile;             // Current movement
+    Motion_Path path;                   // Current coordinated movement
+
+    // Motion plan execution
+    Motion_Plan const* plan;
+    uint16_t plan_step;                 // Step being executed
+    uint16_t plan_rep_start;            // REP_START of the current exercise
+    uint16_t plan_rep;
+    uint32_t plan_rep_start_us;         // First repetition start, throughput
+    bool plan_in_rep;                   // Between REP_START and REPEAT
+    bool plan_paused;
+    bool plan_batch;                    // Ack instead of FINISHED progress
+    bool plan_progress;                 // Report started steps
+
+    // Stall detection
+    uint8_t check_countdown;            // Control periods to the next check
+    Axis_Id check_axis;                 // Axis of the read in flight
+    bool check_pending;
+    int32_t check_expected;             // Position when the read started
+    uint32_t check_count;
+    uint32_t check_us_total;            // Checker CPU time
+    uint32_t check_us_max;
+    uint16_t check_resyncs;
+    uint8_t check_misses;               // Consecutive reads lost
+    uint16_t check_missed;
 }Motors;
 
 
@@ -217,8 +319,42 @@ static void Motors_dispatch(Motors * const this,
 
 void Motors_ctor(Motors * const this);
 
-static uint16_t read_encoder1(void);
-static uint16_t read_encoder2(void);
+static void Motors_Homing_ctor(Motors_Homing * const homing,
+                               StepperMotor* motor,
+                               const Motors_Homing_Config* config);
+static Motors_AO_Homing_state Motors_Homing_run(Motors_Homing * const homing);
+static void motors_error(Motors * const this, Motors_Axis const* axis,
+                         char const* problem);
+static bool calib_matches(uint16_t reading, uint32_t zero);
+static void fast_boot_reject(Motors * const this, char const* reason);
+
+static void Motors_Axis_ctor(Motors_Axis * const axis, AS5600_Bus* encoders,
+                             const Motors_Axis_Config* config);
+static void Motors_Axis_update_angle(Motors_Axis * const axis, uint16_t read);
+static void Motors_publish(Motors * const this);
+static void Motors_Axis_start_centering(Motors * const this);
+static Motors_Axis* encoder_axis(Motors * const this, uint8_t encoder);
+static Axis_Id signal_axis(Signal sig);
+static bool read_encoder(Motors * const this, Axis_Id axis);
+
+static void Motors_start_move(Motors * const this, Axis_Id axis, 
+                              int32_t deg10, uint16_t speed);
+static uint32_t speed_freq(Motors_Axis const* axis, uint16_t speed);
+static bool Motors_move_tick(Motors * const this);
+static void Motors_start_path(Motors * const this, 
+                              Motion_Plan_Step const* step);
+static bool Motors_path_tick(Motors * const this);
+static void Motors_plan_start(Motors * const this, Motion_Plan const* plan,
+                              bool batch, bool progress);
+static void Motors_plan_run(Motors * const this);
+static bool Motors_stall_sample(Motors * const this, Axis_Id axis);
+static bool Motors_stall_miss(Motors * const this);
+static bool Motors_stall_check(Motors * const this, 
+                               MOTORS_AO_ENCODER_PL const* read);
+static void Motors_stall_report(Motors * const this);
+static void plan_progress(Motors * const this, Motion_Plan_Step const* step);
+static void encoder_read_done(void* context, uint8_t encoder, uint16_t angle,
+                              bool ok);
 
 
 #ifdef __cplusplus
@@ -41,6 +41,14 @@ extern Active *AO_Motors;
 
 /* Constants definitions -----------------------------------------------------*/
 
+#define UI_MEASURE_REFRESH_MS 100   // Live angle sampling period
+
+#define UI_ANGLE_BAR_COL 7          // Angle bar, after the value
+#define UI_ANGLE_BAR_SPAN 900       // Bar covers -90..90 deg (deg10)
+#define UI_HOLD_BAR_COL 8           // Hold countdown bar, after "Hold N"
+
+#define UI_FORMAT_BENCHMARK 0       // Compare text_format and sprintf at start
+#define UI_BENCHMARK_CALLS 1000     // Values formatted per method
 
 /* AO Class input Signals ----------------------------------------------------*/
 
@@ -60,19 +68,24 @@ enum UI_Signals {
     UI_AO_SW5_PRESSED_SIG,
     //Signals from motors and encoders
     UI_AO_ACK_CALIB_SIG,
-    UI_AO_ACK_DEG_M1_SIG, 
-    UI_AO_ACK_DEG_M2_SIG,
     UI_AO_ACK_MOVE_SIG,
+    UI_AO_NACK_MOVE_SIG,            // Batch rejected, nothing moved
+    UI_AO_PLAN_PROGRESS_SIG,
     //Error
     UI_AO_ERROR_SIG
 };
 
 
+// Menus are const tables in flash. Rows that show values point to RAM
+// buffers, only those rows and SHOW_EXERCISES' descriptor use RAM.
 typedef struct{
-    char title[20];
-    uint num_of_options;
-    char options[10][20];            
-}UI_State;
+    char const* title;
+    char const* const* options;         // num_of_options rows of 20 chars
+    uint8_t num_of_options;
+}UI_Menu;
+
+#define UI_MENU(title, options) \
+    {(title), (options), sizeof(options)/sizeof((options)[0])}
 
 
 typedef struct{
@@ -81,6 +94,7 @@ typedef struct{
     int16_t lim_min;
     int16_t lim_max;
     uint time_pos;          
+    uint speed;             // Peak joint speed (deg/s), 0: axis maximum
 }Exercise;
 
 typedef struct{
@@ -91,13 +105,16 @@ typedef struct{
 
 typedef struct{
     Event super;
-    int32_t angle;       
-}UI_AO_ANGLE_PL;
+    char error_message[20];     
+}UI_AO_ERROR_PL;
 
 typedef struct{
     Event super;
-    char error_message[20];     
-}UI_AO_ERROR_PL;
+    uint8_t phase;          // Motion_Plan_Phase
+    uint8_t exercise;
+    uint16_t rep;
+    int32_t value;          // Target (deg10) or duration (ms)
+}UI_AO_PLAN_PROGRESS_PL;
     
 
 /* AO Class Data -------------------------------------------------------------*/
@@ -119,6 +136,7 @@ typedef struct {
         UI_AO_POS_BAR_ST,
         UI_AO_MEASURE_ANGLE_ST,
         UI_AO_TIME_ST,
+        UI_AO_SPEED_ST,
         UI_AO_EXERCISE_READY_ST,
         UI_AO_BEGIN_ROUTINE_ST,
         UI_AO_SET_PAUSE_ST,
@@ -129,16 +147,9 @@ typedef struct {
         UI_AO_SEE_AN_EXERCISE_ST,
         UI_AO_DO_ROUTINE_NOW_ST,
         UI_AO_COUNTDOWN_ST,
-        UI_AO_CENTER_DEVICE_ST,
-        UI_AO_MOVE_BAR_ST,
-        UI_AO_MOVE_TO_MIN_ANGLE_ST,
-        UI_AO_MOVE_TO_MAX_ANGLE_ST,
-        UI_AO_END_OF_REPETITION_ST,
-        UI_AO_END_OF_EXERCISE_ST,
+        UI_AO_RUN_ROUTINE_ST,
         UI_AO_FINISH_ST,
         UI_AO_ERROR_ST,
-        UI_AO_END1_ST,
-        UI_AO_END2_ST,
         UI_AO_SET_MAX_ANGLE_ST,
         UI_AO_SET_MIN_ANGLE_ST
     }state;
@@ -148,6 +159,7 @@ typedef struct {
     int16_t default_min_angle;
     int16_t default_max_angle;
     int8_t default_time_in_position;
+    int8_t default_speed;
     int8_t default_pause_between_exercises;
 
     // exercise parameters
@@ -156,11 +168,13 @@ typedef struct {
     int16_t min_angle;
     int16_t max_angle;
     int8_t time_in_position;
+    int8_t speed;
     int8_t pause_between_exercises;
 
     // limit values for exercise parameters
     int8_t max_reps;
     int8_t max_secs;
+    int8_t max_speed;
     int8_t max_pause;
 
     // Value for exercise type
@@ -200,21 +214,24 @@ void UI_ctor(UI * const this);
 
 
 /* AO Class methods ----------------------------------------------------------*/
-void display_row1(char* text);
-void display_row2(char* text);
-void display_row3(char* text);
-void display_row4(char* text);
-void display_rows(char* text1, char* text2, char* text3, char* text4);
-void select_option(char* text);
-void display_plus_button(UI_State estado);
-void display_minus_button(UI_State estado);
-void display_inicio(UI_State estado);
-void change_string(char * base, int l, char* addition);
-void UI_show_inicio(UI_State estado);
-void UI_show_plus_button(UI_State estado);
-void UI_show_minus_button(UI_State estado);
+void display_row1(char const* text);
+void display_row2(char const* text);
+void display_row3(char const* text);
+void display_row4(char const* text);
+void display_rows(char const* text1, char const* text2, char const* text3,
+                  char const* text4);
+void select_option(char const* text);
+void display_plus_button(UI_Menu const* menu);
+void display_minus_button(UI_Menu const* menu);
+void display_inicio(UI_Menu const* menu);
+void change_string(char * base, int l, char const* addition);
 void UI_show(char* row1, char* row2, char* row3, char* row4);
 void UI_selec(char* a);
+static void put_angle(char* row, int32_t deg10, bool tenths);
+static int16_t measured_angle(UI const * const this);
+#if UI_FORMAT_BENCHMARK
+static void UI_format_benchmark(void);
+#endif
 #ifdef __cplusplus
 }
 #endif
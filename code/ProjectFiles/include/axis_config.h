@@ -0,0 +1,86 @@
+/**
+  ******************************************************************************
+  * @file    axis_config.h
+  * @author  Camilo Vera
+  * @brief   Mechanism axes
+  *          Constants of every axis, shared by the C motion code and the C++
+  *          table generation. An axis n is described by its MOTORn_ block and
+  *          enabled by adding n to AXIS_LIST.
+  ******************************************************************************
+*/
+
+#ifndef AXIS_CONFIG_H
+#define AXIS_CONFIG_H
+
+/* Axes ----------------------------------------------------------------------*/
+
+#define AXIS_LIST(X) \
+    X(1)             \
+    X(2)
+
+typedef enum{
+#define AXIS_ID(n) AXIS_M##n,
+    AXIS_LIST(AXIS_ID)
+#undef AXIS_ID
+    AXIS_COUNT
+}Axis_Id;
+
+/* Motor 1 -------------------------------------------------------------------*/
+
+#define MOTOR1_STEP_PIN 2
+#define MOTOR1_DIR_PIN 3
+#define MOTOR1_ENABLE_PIN 4
+#define MOTOR1_PIO pio0
+#define MOTOR1_PIO_SM 0
+
+#define ENCODER1_SDA_PIN 10
+#define ENCODER1_SCL_PIN 11
+#define ENCODER1_OFFSET 0               // Added to every raw reading
+#define END_SWITCH_1 8
+
+#define MOTOR1_DEG_RANGE [-90, 110]     // End sensor at 110°
+#define MOTOR1_DEG_RANGE_LEN 100
+#define MOTOR1_DEG10_MIN -900           // Valid targets, deg10
+#define MOTOR1_DEG10_MAX 1100
+#define MOTOR1_TRANSMISSION_RATE 3
+#define MOTOR1_STEPS_PER_REV 200
+#define MOTOR1_FULL_RANGE_STEPS 300     // TODO Number of steps in valid range
+#define MOTOR1_HOME_TO_CENTER_STEPS 153
+#define MOTOR1_STEPS_PER_OUTPUT_REV (MOTOR1_TRANSMISSION_RATE*MOTOR1_STEPS_PER_REV)
+
+#define MOTOR1_POS_DIR  1    //(+)      // CCW positive right hand rule
+#define MOTOR1_NEG_DIR  0    //(-)
+#define ENCODER1_POS_DIR 1
+#define MOTOR1_ENCODER_FIX false        // Encoder fine centering after freeing
+
+/* Motor 2 -------------------------------------------------------------------*/
+
+#define MOTOR2_STEP_PIN 5
+#define MOTOR2_DIR_PIN 6
+#define MOTOR2_ENABLE_PIN 7
+#define MOTOR2_PIO pio1
+#define MOTOR2_PIO_SM 0
+
+#define ENCODER2_SDA_PIN 14
+#define ENCODER2_SCL_PIN 15
+#define ENCODER2_OFFSET 0
+#define END_SWITCH_2 9
+
+#define MOTOR2_DEG_RANGE [-90, 90]
+#define MOTOR2_DEG_RANGE_LEN 180
+#define MOTOR2_DEG10_MIN -900
+#define MOTOR2_DEG10_MAX 900
+#define MOTOR2_TRANSMISSION_RATE 1
+#define MOTOR2_STEPS_PER_REV 200
+#define MOTOR2_FULL_RANGE_STEPS 100     // NUmber of steps in valid range
+#define MOTOR2_HOME_TO_CENTER_STEPS 58
+#define MOTOR2_STEPS_PER_OUTPUT_REV (MOTOR2_TRANSMISSION_RATE*MOTOR2_STEPS_PER_REV)
+
+#define MOTOR2_POS_DIR  0   //(+)       // CCW positive right hand rule
+#define MOTOR2_NEG_DIR  1   //(-)
+#define ENCODER2_POS_DIR 0
+#define MOTOR2_ENCODER_FIX true
+
+#endif // AXIS_CONFIG_H
+
+/************************ Camilo Vera **************************END OF FILE****/
@@ -0,0 +1,90 @@
+/** 
+  ******************************************************************************
+  * @file    calib_flash.h
+  * @author  Camilo Vera
+  * @brief   Calibration storage
+  *          Keeps the mechanism calibration in the last flash sector so it
+  *          survives power cycles.
+  ****************************************************************************** 
+*/
+
+#ifndef CALIB_FLASH_H
+#define CALIB_FLASH_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+
+// Standard C libraries
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+// SDK Libraries
+#include "pico/stdlib.h"
+#include "hardware/flash.h"
+
+// Project libraries
+#include "axis_config.h"
+
+/* Constants definitions -----------------------------------------------------*/
+
+#define CALIB_FLASH_MAGIC 0x43414C42    // "CALB"
+#define CALIB_FLASH_VERSION 2           // Increase when Calib_Data changes
+
+// Reserved sector, the last one of the flash. Records are appended one per
+// page, the sector is only erased when full.
+#define CALIB_FLASH_OFFSET (PICO_FLASH_SIZE_BYTES - FLASH_SECTOR_SIZE)
+#define CALIB_FLASH_RECORDS (FLASH_SECTOR_SIZE / FLASH_PAGE_SIZE)
+
+#define CALIB_FLASH_TOLERANCE 4         // Encoder counts, zeros closer than
+                                        // this are not stored again
+
+/* Types ---------------------------------------------------------------------*/
+
+typedef struct{
+    uint32_t magic;
+    uint16_t version;
+    uint16_t reserved;
+    uint32_t mechanism_id;              // Mechanism the calibration belongs to
+    uint32_t encoder_zero[AXIS_COUNT];
+    uint32_t checksum;                  // CRC-32 of the previous fields
+}Calib_Data;
+
+/* Functions -----------------------------------------------------------------*/
+
+/**
+ * @brief Erase the sector if no page is left for a new record. The erase
+ * stalls every interrupt for tens of ms, so it must run before the scheduler
+ * starts.
+ */
+void Calib_flash_init(void);
+
+/**
+ * @brief Load the newest stored calibration
+ *
+ * @param data Loaded calibration
+ * @param mechanism_id Expected mechanism
+ * @return true if a valid calibration for this mechanism was found
+ */
+bool Calib_flash_load(Calib_Data* data, uint32_t mechanism_id);
+
+/**
+ * @brief Store a calibration in the next free page, unless its zeros are
+ * within CALIB_FLASH_TOLERANCE of the stored ones. Never erases, interrupts
+ * are only disabled while the page is programmed (about 1 ms).
+ *
+ * @param data Calibration, magic, version and checksum are filled in
+ * @return true if the flash was written
+ */
+bool Calib_flash_save(Calib_Data* data);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // CALIB_FLASH_H
+
+/************************ Camilo Vera **************************END OF FILE****/
@@ -1,85 +1,137 @@
-// Copyright 2021 Ocean (iiot2k@gmail.com) 
-// All rights reserved.
-
-/*!
-    @mainpage ../README.md
-    @name dev_hd44780 - HD44780 LCD Driver with PCF8574
-    @file dev_hd44780.h
-    @lib dev_hd44780
-    @n
-*/
-
-/*! $## **Description:**
-    The Hitachi HD44780 LCD controller drives alphanumeric LCD displays
-    with 2x16 (1602) or 4x20 (2004) LCD displays.
-    This driver supports HD44780 with I2C on PCF8574 port expander.
-    Use level shifter to interface with Raspberry Pico.
-    LCD needs 5V for valid operation or use 3.3V LCD displays.  
-*/
-
-/*! $### 2004 and 1602 LCD Display
-    @image images\hd44780.png
-    @n
-*/
-
-#ifndef _DEV_HD44780_H_
-#define _DEV_HD44780_H_
-
-#ifdef __cplusplus
-extern "C" {
-#endif
-
-#include <stdint.h>
-#include <stdbool.h>
-
-
-#include "hardware/i2c.h"
-#include "hardware/timer.h"
-
-// FreeRTOS
-#include <FreeRTOS.h>
-#include <task.h>
-
-#define init_wait_ms(ms) busy_wait_ms(ms)
-#define init_wait_us(us) busy_wait_us(us)
-#define running_wait_ms(ms) vTaskDelay(ms)
-#define running_wait_us(us) busy_wait_us(us)
-
-
-//#include "sys_i2c.h"
-
-/*! $## **Functions:**
-    @--
-*/
-
-/*! @brief - Init hd44780
-    @param i2c I2c channel i2c0 or i2c1
-    @param addr I2c address (0x27..)
-*/
-void dev_hd44780_init(i2c_inst_t* i2c, uint8_t addr);
-
-/*! @brief Write text to hd44780 lcd
-    @param i2c I2c channel i2c0 or i2c1
-    @param addr I2c address (0x27..)
-    @param line Line number 0..3 (4 line lcd), 0..1 (2 line lcd)
-    @param is4line True for 4 line lcd type
-    @param txt Text in format col;text, without col format, text is written to column 0
-*/
-void dev_hd44780_text(i2c_inst_t* i2c, uint8_t addr, uint8_t line, bool is4line, uint8_t* txt);
-
-/*! @brief Display bargraph on hd44780 lcd
-    @param i2c I2c channel i2c0 or i2c1
-    @param addr I2c address (0x27..)
-    @param line Line number 0..3 (4 line lcd), 0..1 (2 line lcd)
-    @param is4line True for 4 line lcd type
-    @param data In range 0..100 
-*/
-void dev_hd44780_bargraph(i2c_inst_t* i2c, uint8_t addr, uint8_t line, bool is4line, uint8_t data);
-
-
-
-#ifdef __cplusplus
-}
-#endif
-
-#endif // _DEV_HD44780_H_
+// Copyright 2021 Ocean (iiot2k@gmail.com) 
+// All rights reserved.
+
+/*!
+    @mainpage ../README.md
+    @name dev_hd44780 - HD44780 LCD Driver with PCF8574
+    @file dev_hd44780.h
+    @lib dev_hd44780
+    @n
+*/
+
+/*! $## **Description:**
+    The Hitachi HD44780 LCD controller drives alphanumeric LCD displays
+    with 2x16 (1602) or 4x20 (2004) LCD displays.
+    This driver supports HD44780 with I2C on PCF8574 port expander.
+    Use level shifter to interface with Raspberry Pico.
+    LCD needs 5V for valid operation or use 3.3V LCD displays.  
+*/
+
+/*! $### 2004 and 1602 LCD Display
+    @image images\hd44780.png
+    @n
+*/
+
+#ifndef _DEV_HD44780_H_
+#define _DEV_HD44780_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+
+
+#include "hardware/i2c.h"
+#include "hardware/timer.h"
+
+// FreeRTOS
+#include <FreeRTOS.h>
+#include <task.h>
+
+#define init_wait_ms(ms) busy_wait_ms(ms)
+#define init_wait_us(us) busy_wait_us(us)
+#define running_wait_ms(ms) vTaskDelay(ms)
+#define running_wait_us(us) busy_wait_us(us)
+
+
+//#include "sys_i2c.h"
+
+/*! @brief Transfer modes
+*/
+typedef enum {
+    HD44780_MODE_TIMED,     // one transaction per write and fixed waits
+    HD44780_MODE_PACKED,    // one transaction per string, paced by the bus
+    HD44780_MODE_BUSY       // one transaction per byte, then busy flag polling
+} dev_hd44780_mode_t;
+
+/*! $## **Functions:**
+    @--
+*/
+
+/*! @brief - Init hd44780
+    @param i2c I2c channel i2c0 or i2c1
+    @param addr I2c address (0x27..)
+*/
+void dev_hd44780_init(i2c_inst_t* i2c, uint8_t addr);
+
+/*! @brief Write text to hd44780 lcd
+    @param i2c I2c channel i2c0 or i2c1
+    @param addr I2c address (0x27..)
+    @param line Line number 0..3 (4 line lcd), 0..1 (2 line lcd)
+    @param is4line True for 4 line lcd type
+    @param txt Text in format col;text, without col format, text is written to column 0
+*/
+void dev_hd44780_text(i2c_inst_t* i2c, uint8_t addr, uint8_t line, bool is4line, uint8_t* txt);
+
+/*! @brief Write characters at a position, without parsing or padding
+    @param i2c I2c channel i2c0 or i2c1
+    @param addr I2c address (0x27..)
+    @param line Line number 0..3 (4 line lcd), 0..1 (2 line lcd)
+    @param is4line True for 4 line lcd type
+    @param col First column
+    @param data Characters, clipped at the end of the line
+    @param len Number of characters
+*/
+void dev_hd44780_write_at(i2c_inst_t* i2c, uint8_t addr, uint8_t line, bool is4line, uint8_t col, const uint8_t* data, uint8_t len);
+
+/*! @brief Pack characters at a position into expander writes, for a
+    transport that sends them on its own as one transaction
+    @param buffer Destination, room for (1 + len) * 4 bytes
+    @param line Line number 0..3 (4 line lcd), 0..1 (2 line lcd)
+    @param is4line True for 4 line lcd type
+    @param col First column
+    @param data Characters, clipped at the end of the line
+    @param len Number of characters
+    @return Bytes written to buffer, 0 if the position is invalid
+*/
+uint16_t dev_hd44780_pack_at(uint8_t* buffer, uint8_t line, bool is4line, uint8_t col, const uint8_t* data, uint8_t len);
+
+/*! @brief Define a custom character, shown by writing its slot number
+    @param i2c I2c channel i2c0 or i2c1
+    @param addr I2c address (0x27..)
+    @param slot Character code 0..7
+    @param glyph 8 rows of 5 pixels, top row first, bit 4 is the left column
+*/
+void dev_hd44780_cgram(i2c_inst_t* i2c, uint8_t addr, uint8_t slot, const uint8_t* glyph);
+
+/*! @brief Select how text is transferred, packed by default. Packed mode
+    is paced by the bus, which must not exceed 400 kHz (PCF8574 limit).
+    Busy mode needs R/W wired to the expander (P1), set it before init.
+    @param mode Transfer mode
+*/
+void dev_hd44780_set_mode(dev_hd44780_mode_t mode);
+
+/*! @brief Get the transfer mode, busy mode falls back to timed when the
+    busy flag never clears (R/W not wired) or the module doesn't answer
+    @return Transfer mode in use
+*/
+dev_hd44780_mode_t dev_hd44780_get_mode(void);
+
+/*! @brief Display bargraph on hd44780 lcd
+    @param i2c I2c channel i2c0 or i2c1
+    @param addr I2c address (0x27..)
+    @param line Line number 0..3 (4 line lcd), 0..1 (2 line lcd)
+    @param is4line True for 4 line lcd type
+    @param data In range 0..100 
+*/
+void dev_hd44780_bargraph(i2c_inst_t* i2c, uint8_t addr, uint8_t line, bool is4line, uint8_t data);
+
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _DEV_HD44780_H_
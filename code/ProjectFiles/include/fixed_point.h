@@ -0,0 +1,70 @@
+/** 
+  ******************************************************************************
+  * @file    fixed_point.h
+  * @author  Camilo Vera
+  * @brief   Fixed point math
+  *          Angle units, rounded integer division and a Q16.16 type. The
+  *          RP2040 has no FPU, so motion code must not use float. Unit
+  *          conversions are the tables of motion_tables.h.
+  ****************************************************************************** 
+*/
+
+#ifndef FIXED_POINT_H
+#define FIXED_POINT_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+
+// Standard C libraries
+#include <stdint.h>
+
+/* Constants definitions -----------------------------------------------------*/
+
+#define FP_DEG10_PER_REV 3600           // Angles are in tenths of degree
+#define FP_COUNTS_PER_REV 4096          // AS5600 resolution
+
+#define Q16_ONE 65536                   // 1.0 in Q16.16
+
+/* Types ---------------------------------------------------------------------*/
+
+typedef int32_t q16_t;                  // Q16.16, range ±32767
+
+/* Functions -----------------------------------------------------------------*/
+
+/**
+ * @brief Integer division rounded to nearest, halves away from zero
+ *
+ * @param num Numerator
+ * @param den Denominator, must be positive
+ */
+static inline int32_t fp_div_round(int32_t num, int32_t den){
+    return num >= 0 ? (num + den/2) / den : -((-num + den/2) / den);
+}
+
+static inline q16_t q16_from_int(int32_t value){
+    return value * Q16_ONE;
+}
+
+static inline q16_t q16_from_ratio(int32_t num, int32_t den){
+    return (q16_t)(((int64_t)num * Q16_ONE + (num >= 0 ? den/2 : -den/2)) / den);
+}
+
+static inline int32_t q16_to_int(q16_t value){
+    return fp_div_round(value, Q16_ONE);
+}
+
+static inline q16_t q16_mul(q16_t a, q16_t b){
+    int64_t product = (int64_t)a * b;
+    return (q16_t)((product + (product >= 0 ? Q16_ONE/2 : -Q16_ONE/2)) / Q16_ONE);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // FIXED_POINT_H
+
+/************************ Camilo Vera **************************END OF FILE****/
@@ -0,0 +1,59 @@
+/**
+  ******************************************************************************
+  * @file    lcd_bar.h
+  * @author  Camilo Vera
+  * @brief   LCD bargraph
+  *          Bars drawn with partial block glyphs kept in the HD44780 CGRAM,
+  *          five steps per character cell. Bars are plain characters of a
+  *          row, so the shadow framebuffer only sends the cells that change.
+  ******************************************************************************
+*/
+
+#ifndef LCD_BAR_H
+#define LCD_BAR_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+
+// Standard C libraries
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Constants definitions -----------------------------------------------------*/
+
+#define LCD_BAR_CELL_STEPS 5            // Pixel columns of a character cell
+#define LCD_BAR_GLYPHS (LCD_BAR_CELL_STEPS - 1)
+#define LCD_BAR_FIRST_GLYPH 1           // CGRAM slot of 1 column, 0 is '\0'
+#define LCD_BAR_FULL 0xFF               // Full block of the character ROM
+#define LCD_BAR_GLYPH_ROWS 8
+
+/* Variables -----------------------------------------------------------------*/
+
+/**
+ * @brief Glyph g lights the g + 1 leftmost columns, to be written to CGRAM
+ * slot LCD_BAR_FIRST_GLYPH + g
+ */
+extern const uint8_t lcd_bar_glyphs[LCD_BAR_GLYPHS][LCD_BAR_GLYPH_ROWS];
+
+/* Functions -----------------------------------------------------------------*/
+
+/**
+ * @brief Draw value out of full as a bar of width cells, from col
+ *
+ * @param row Display row, cells past its 20 characters are clipped
+ * @param value Clamped to 0..full
+ * @param full Value of a full bar, the bar is empty if not positive
+ */
+void Lcd_bar_render(char* row, uint8_t col, uint8_t width, int32_t value,
+                    int32_t full);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // LCD_BAR_H
+
+/************************ Camilo Vera **************************END OF FILE****/
@@ -0,0 +1,95 @@
+/**
+  ******************************************************************************
+  * @file    lcd_dma.h
+  * @author  Camilo Vera
+  * @brief   LCD DMA transport
+  *          Sends a packed HD44780/PCF8574 byte stream as one I2C write fed
+  *          by DMA. The I2C stop interrupt reports the end of the transfer,
+  *          so the CPU is free while the display is written.
+  ******************************************************************************
+*/
+
+#ifndef LCD_DMA_H
+#define LCD_DMA_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+
+// Standard C libraries
+#include <stdint.h>
+#include <stdbool.h>
+
+// SDK Libraries
+#include "pico/stdlib.h"
+#include "hardware/i2c.h"
+#include "hardware/dma.h"
+#include "hardware/irq.h"
+
+/* Constants definitions -----------------------------------------------------*/
+
+#define LCD_DMA_MAX_BYTES 336           // Whole 4x20 screen, packed
+#define LCD_DMA_TIMEOUT_US 20000        // Stale transfer is aborted after it
+
+/* Types ---------------------------------------------------------------------*/
+
+/**
+ * @brief Transfer completion, executed in interrupt context
+ *
+ * @param context User context given to Lcd_dma_init
+ * @param ok false if the display did not acknowledge
+ */
+typedef void (*Lcd_Dma_Callback)(void* context, bool ok);
+
+typedef struct{
+    i2c_inst_t* i2c;
+    uint8_t addr;
+    int dma;
+    uint16_t cmds[LCD_DMA_MAX_BYTES];   // DATA_CMD words, stop on the last
+    volatile bool busy;
+    uint32_t start_us;
+    Lcd_Dma_Callback callback;
+    void* context;
+
+    // Statistics
+    uint32_t transfers;
+    uint32_t aborts;
+    uint32_t last_us;                   // Duration of the last transfer
+    uint32_t max_us;
+}Lcd_Dma;
+
+/* Functions -----------------------------------------------------------------*/
+
+/**
+ * @brief Claim a DMA channel and hook the I2C interrupt. The controller must
+ * be initialized and no blocking transfer may run on it afterwards.
+ */
+void Lcd_dma_init(Lcd_Dma* this, i2c_inst_t* i2c, uint8_t addr,
+                  Lcd_Dma_Callback callback, void* context);
+
+/**
+ * @brief Check whether a new transfer can start, a transfer older than
+ * LCD_DMA_TIMEOUT_US is aborted
+ */
+bool Lcd_dma_ready(Lcd_Dma* this);
+
+/**
+ * @brief Start sending a packed stream and return immediately
+ *
+ * @param data Expander writes, copied before returning
+ * @param len At most LCD_DMA_MAX_BYTES
+ * @return false if a transfer is still in flight
+ */
+bool Lcd_dma_send(Lcd_Dma* this, uint8_t const* data, uint16_t len);
+
+void Lcd_dma_abort(Lcd_Dma* this);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // LCD_DMA_H
+
+/************************ Camilo Vera **************************END OF FILE****/
@@ -0,0 +1,89 @@
+/**
+  ******************************************************************************
+  * @file    lcd_frame.h
+  * @author  Camilo Vera
+  * @brief   LCD shadow framebuffer
+  *          Keeps a copy of what the display shows and sends only the cells
+  *          that change, as runs of characters behind one cursor move.
+  ******************************************************************************
+*/
+
+#ifndef LCD_FRAME_H
+#define LCD_FRAME_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+
+// Standard C libraries
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Constants definitions -----------------------------------------------------*/
+
+#define LCD_ROWS 4
+#define LCD_COLS 20
+
+// A cursor move costs one byte, so unchanged gaps up to this length are
+// rewritten instead of starting a new run
+#define LCD_FRAME_MERGE_GAP 1
+
+/* Types ---------------------------------------------------------------------*/
+
+typedef struct{
+    uint8_t glass[LCD_ROWS][LCD_COLS];  // What the display shows
+    uint8_t next[LCD_ROWS][LCD_COLS];   // What it must show
+    bool dirty[LCD_ROWS];
+
+    // Statistics, bytes are cursor moves plus characters
+    uint32_t flushes;
+    uint32_t bytes_sent;
+    uint32_t bytes_saved;               // Against rewriting every dirty row
+}Lcd_Frame;
+
+/**
+ * @brief Sends len characters starting at row, col
+ */
+typedef void (*Lcd_Frame_Writer)(void* context, uint8_t row, uint8_t col,
+                                 uint8_t const* data, uint8_t len);
+
+/* Functions -----------------------------------------------------------------*/
+
+/**
+ * @brief Start from a blank display, as left by dev_hd44780_init()
+ */
+void Lcd_frame_init(Lcd_Frame* frame);
+
+/**
+ * @brief Replace the content of a row from column 0, up to the end of text
+ * or LCD_COLS characters. Cells after a short text keep their content.
+ */
+void Lcd_frame_set_row(Lcd_Frame* frame, uint8_t row, char const* text);
+
+/**
+ * @brief Check whether any row changed since the last flush
+ */
+bool Lcd_frame_pending(Lcd_Frame const* frame);
+
+/**
+ * @brief Forget what the display shows, the next flush rewrites every cell
+ */
+void Lcd_frame_invalidate(Lcd_Frame* frame);
+
+/**
+ * @brief Send the differences between next and glass
+ *
+ * @return Bytes sent
+ */
+uint32_t Lcd_frame_flush(Lcd_Frame* frame, Lcd_Frame_Writer writer,
+                         void* context);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // LCD_FRAME_H
+
+/************************ Camilo Vera **************************END OF FILE****/
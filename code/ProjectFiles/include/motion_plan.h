@@ -0,0 +1,121 @@
+/** 
+  ******************************************************************************
+  * @file    motion_plan.h
+  * @author  Camilo Vera
+  * @brief   Routine motion plan
+  *          Compiles a whole exercise routine into a flat list of timed 
+  *          motion steps, executed autonomously by the Motors AO.
+  ****************************************************************************** 
+*/
+
+#ifndef MOTION_PLAN_H
+#define MOTION_PLAN_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+
+// Standard C libraries
+#include <stdint.h>
+#include <stdbool.h>
+
+// Project libraries
+#include "axis_config.h"
+#include "UI_AO.h"
+
+/* Constants definitions -----------------------------------------------------*/
+
+#define MOTION_PLAN_MAX_STEPS 128       // 10 steps per exercise plus the end
+
+#define MOTION_PLAN_BAR_SETTLE_MS 2000  // Wait after positioning the bar
+#define MOTION_PLAN_END_DELAY_MS 1000   // Wait before the final centering
+#define MOTION_PLAN_BAR_HORIZONTAL -900 // M2 position for Ab-,Adduction
+#define MOTION_PLAN_BAR_VERTICAL 0
+
+/* Types ---------------------------------------------------------------------*/
+
+typedef enum{
+    MOTION_PLAN_MOVE,                   // Move axis to value (deg10)
+    MOTION_PLAN_HOLD,                   // Wait value (ms)
+    MOTION_PLAN_REP_START,              // First step of a repetition
+    MOTION_PLAN_REPEAT,                 // Back to REP_START until value reps
+    MOTION_PLAN_LINE,                   // M1 to value and M2 to aux together
+    MOTION_PLAN_CIRCLE                  // One turn of radius value around aux
+}Motion_Plan_Op;
+
+// Reported to the UI when a step starts
+typedef enum{
+    MOTION_PLAN_POSITION_BAR,
+    MOTION_PLAN_TO_MIN,
+    MOTION_PLAN_HOLD_MIN,
+    MOTION_PLAN_TO_MAX,
+    MOTION_PLAN_HOLD_MAX,
+    MOTION_PLAN_TO_START,               // Coordinated path start point
+    MOTION_PLAN_CIRCLE_PATH,
+    MOTION_PLAN_CENTER,
+    MOTION_PLAN_PAUSE,                  // Between exercises
+    MOTION_PLAN_END,
+    MOTION_PLAN_FINISHED,
+    MOTION_PLAN_WAYPOINT,               // Batch move, exercise is the index
+    MOTION_PLAN_DWELL
+}Motion_Plan_Phase;
+
+typedef struct{
+    uint8_t op;                         // Motion_Plan_Op
+    uint8_t phase;                      // Motion_Plan_Phase
+    uint8_t axis;                       // Axis_Id
+    uint8_t exercise;
+    uint16_t speed;                     // Moves, deg/s (0: axis maximum)
+    int16_t aux;                        // Second operand of LINE and CIRCLE
+    int32_t value;
+}Motion_Plan_Step;
+
+typedef struct{
+    uint8_t axis;                       // Axis_Id
+    uint16_t speed;                     // deg/s, 0: axis maximum
+    int16_t target;                     // deg10
+    uint16_t dwell_ms;                  // Wait once the target is reached
+}Motion_Waypoint;
+
+typedef struct{
+    uint16_t num_steps;
+    Motion_Plan_Step steps[MOTION_PLAN_MAX_STEPS];
+}Motion_Plan;
+
+/* Functions -----------------------------------------------------------------*/
+
+// Exercise types that move M1 and M2 along one path
+#define MOTION_PLAN_CIRCUMDUCTION 3     // Circle of the min/max range 
+#define MOTION_PLAN_DIAGONAL 4          // (min, min) to (max, max)
+
+/**
+ * @brief Compile a routine. Every exercise positions the bar, repeats 
+ * min/hold/max/hold at the exercise speed and is followed by centering and
+ * the routine pause. Bar positioning and centering run at the axis maximum.
+ *
+ * @param plan Output plan
+ * @param routine Routine to compile
+ * @return false if the routine does not fit in MOTION_PLAN_MAX_STEPS
+ */
+bool Motion_plan_compile(Motion_Plan* plan, Routine const* routine);
+
+/**
+ * @brief Compile a sequence of waypoints, one MOVE per waypoint followed by
+ * a HOLD when it has a dwell
+ *
+ * @return false if a waypoint has an unknown axis or a target out of the
+ * MOTORn_DEG10_MIN/MAX range, or if the waypoints do not fit in
+ * MOTION_PLAN_MAX_STEPS
+ */
+bool Motion_plan_waypoints(Motion_Plan* plan, Motion_Waypoint const* waypoints,
+                           uint8_t count);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // MOTION_PLAN_H
+
+/************************ Camilo Vera **************************END OF FILE****/
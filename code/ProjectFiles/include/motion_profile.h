@@ -0,0 +1,124 @@
+/** 
+  ******************************************************************************
+  * @file    motion_profile.h
+  * @author  Camilo Vera
+  * @brief   Smooth motion profiles
+  *          Samples a normalized trajectory shape at a fixed control period
+  *          into step chunks and step rates, integer arithmetic only.
+  *          Paths coordinate all axes on one time base.
+  ****************************************************************************** 
+*/
+
+#ifndef MOTION_PROFILE_H
+#define MOTION_PROFILE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+
+// Standard C libraries
+#include <stdint.h>
+#include <stdbool.h>
+
+// Project libraries
+#include "axis_config.h"
+#include "motion_tables.h"
+
+/* Constants definitions -----------------------------------------------------*/
+
+#define MOTION_CONTROL_PERIOD_MS 10
+#define MOTION_CHUNK_FILL 90            // % of the period used by a chunk
+#define MOTION_TWO_PI 6283              // Thousandths
+
+/* Types ---------------------------------------------------------------------*/
+
+typedef struct{
+    Motion_Shape shape;
+    uint32_t distance;                  // Steps
+    uint32_t duration_ms;               // Multiple of the control period
+    uint32_t elapsed_ms;
+    uint32_t sent;                      // Steps already issued
+}Motion_Profile;
+
+typedef enum{
+    MOTION_PATH_LINE,                   // Straight segment in joint space
+    MOTION_PATH_CIRCLE                  // Closed loop, axis n lags n quarters
+}Motion_Path_Kind;
+
+typedef struct{
+    Motion_Path_Kind kind;
+    Motion_Shape shape;                 // Timing along the path
+    int32_t origin[AXIS_COUNT];         // LINE: start, CIRCLE: center (steps)
+    int32_t extent[AXIS_COUNT];         // LINE: end - start, CIRCLE: radius
+    uint32_t duration_ms;               // Multiple of the control period
+    uint32_t elapsed_ms;
+}Motion_Path;
+
+/* Functions -----------------------------------------------------------------*/
+
+/**
+ * @brief Plan a rest to rest move, the duration is the shortest one that
+ * keeps the shape peak velocity under max_freq
+ *
+ * @param distance Steps to move
+ * @param max_freq Peak step rate (steps/s)
+ */
+void Motion_profile_init(Motion_Profile* profile, Motion_Shape shape,
+                         uint32_t distance, uint32_t max_freq);
+
+/**
+ * @brief Advance one control period
+ *
+ * @param steps Steps to issue during this period, may be 0
+ * @return true when this was the last period
+ */
+bool Motion_profile_next(Motion_Profile* profile, uint16_t* steps);
+
+/**
+ * @brief Step rate that spreads a chunk over MOTION_CHUNK_FILL % of the 
+ * control period, so chunks never pile up in the PIO FIFO
+ */
+uint32_t Motion_profile_freq(uint16_t steps);
+
+/**
+ * @brief Plan a rest to rest straight move of all axes, all of them start
+ * and end together and each one stays under its max_freq
+ *
+ * @param start, end Positions (steps)
+ * @param max_freq Peak step rate of every axis (steps/s)
+ */
+void Motion_path_line(Motion_Path* path, Motion_Shape shape,
+                      int32_t const start[AXIS_COUNT],
+                      int32_t const end[AXIS_COUNT],
+                      uint32_t const max_freq[AXIS_COUNT]);
+
+/**
+ * @brief Plan one turn around center starting and ending at rest, the first
+ * axis follows center + radius*cos, the second center + radius*sin. The 
+ * path starts at center + radius on the first axis.
+ *
+ * @param center, radius Steps
+ * @param max_freq Peak step rate of every axis (steps/s)
+ */
+void Motion_path_circle(Motion_Path* path, Motion_Shape shape,
+                        int32_t const center[AXIS_COUNT],
+                        int32_t const radius[AXIS_COUNT],
+                        uint32_t const max_freq[AXIS_COUNT]);
+
+/**
+ * @brief Advance one control period
+ *
+ * @param position Absolute position of every axis at the end of the period
+ * @return true when this was the last period
+ */
+bool Motion_path_next(Motion_Path* path, int32_t position[AXIS_COUNT]);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // MOTION_PROFILE_H
+
+/************************ Camilo Vera **************************END OF FILE****/
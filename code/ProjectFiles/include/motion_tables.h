@@ -0,0 +1,79 @@
+/** 
+  ******************************************************************************
+  * @file    motion_tables.h
+  * @author  Camilo Vera
+  * @brief   Motion lookup tables
+  *          Unit conversions and normalized trajectory shapes, generated at 
+  *          compile time (motion_tables.cpp) and stored in flash.
+  ****************************************************************************** 
+*/
+
+#ifndef MOTION_TABLES_H
+#define MOTION_TABLES_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+
+// Standard C libraries
+#include <stdint.h>
+
+// Project libraries
+#include "fixed_point.h"
+#include "axis_config.h"
+
+/* Constants definitions -----------------------------------------------------*/
+
+#define MOTION_SHAPE_SAMPLES 64         // Shape table intervals
+#define MOTION_COS_SAMPLES 64           // Cosine table intervals per quarter
+
+// Peak velocity and acceleration of the normalized shapes, thousandths.
+// A move of D steps in T s peaks at PEAK_VEL*D/T steps/s.
+#define MOTION_SHAPE_MIN_JERK_PEAK_VEL 1875
+#define MOTION_SHAPE_MIN_JERK_PEAK_ACC 5774
+#define MOTION_SHAPE_SINE_PEAK_VEL 1571
+#define MOTION_SHAPE_SINE_PEAK_ACC 4935
+
+/* Types ---------------------------------------------------------------------*/
+
+typedef enum{
+    MOTION_SHAPE_MIN_JERK,              // 10t^3 - 15t^4 + 6t^5
+    MOTION_SHAPE_SINE                   // (1 - cos(pi t)) / 2
+}Motion_Shape;
+
+/* Functions -----------------------------------------------------------------*/
+
+/**
+ * Conversions round to nearest with halves towards +infinity, the tables are
+ * periodic so any integer input is valid.
+ */
+int32_t motion_deg10_to_steps(Axis_Id axis, int32_t deg10);
+int32_t motion_steps_to_deg10(Axis_Id axis, int32_t steps);
+int32_t motion_counts_to_deg10(Axis_Id axis, int32_t counts);
+
+/**
+ * @brief Normalized trajectory shape, linearly interpolated
+ *
+ * @param shape Shape
+ * @param t Normalized time, 0 to Q16_ONE
+ * @return Normalized position, 0 to Q16_ONE
+ */
+q16_t motion_shape(Motion_Shape shape, q16_t t);
+
+/**
+ * @brief Cosine from a quarter wave table, linearly interpolated
+ *
+ * @param turns Angle in turns, any value
+ * @return cos(2 pi turns), -Q16_ONE to Q16_ONE
+ */
+q16_t motion_cos(q16_t turns);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // MOTION_TABLES_H
+
+/************************ Camilo Vera **************************END OF FILE****/
@@ -0,0 +1,85 @@
+/**
+  ******************************************************************************
+  * @file    motors_snapshot.h
+  * @author  Camilo Vera
+  * @brief   Motors state snapshot
+  *          Position, velocity and state published by the Motors AO in a
+  *          double buffer. Any AO reads it without events or blocking the
+  *          writer.
+  ******************************************************************************
+*/
+
+#ifndef MOTORS_SNAPSHOT_H
+#define MOTORS_SNAPSHOT_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+
+// Standard C libraries
+#include <stdint.h>
+#include <stdbool.h>
+
+// Project libraries
+#include "axis_config.h"
+
+/* Defines -------------------------------------------------------------------*/
+
+#define MOTORS_SNAPSHOT_READ_TRIES 3    // Reads torn by two publications
+
+/* Types ---------------------------------------------------------------------*/
+
+typedef struct{
+    int32_t commanded;                  // deg10, from the issued steps
+    int32_t measured;                   // deg10, last encoder read
+    int32_t velocity;                   // deg10/s, between encoder reads
+    uint32_t read_us;                   // Time of the last encoder read
+}Motors_Snapshot_Axis;
+
+typedef struct{
+    Motors_Snapshot_Axis axes[AXIS_COUNT];
+    uint8_t state;                      // Motors_AO_state
+    uint8_t axis;                       // Axis being centered, freed or moved
+    uint32_t updates;                   // Publications so far
+}Motors_Snapshot_Data;
+
+typedef struct{
+    volatile uint32_t sequence;         // Odd while a write is in progress
+    Motors_Snapshot_Data data;
+}Motors_Snapshot_Buffer;
+
+typedef struct{
+    volatile uint8_t active;            // Buffer holding the last publication
+    Motors_Snapshot_Buffer buffers[2];
+}Motors_Snapshot;
+
+/* Functions -----------------------------------------------------------------*/
+
+/**
+ * @brief Publish new data in the inactive buffer and flip the index, single
+ * writer only. Never blocks.
+ */
+void Motors_snapshot_write(Motors_Snapshot* snapshot,
+                           Motors_Snapshot_Data const* data);
+
+/**
+ * @brief Copy the active buffer. The copy is only torn if the writer
+ * publishes twice during it, then it is retried up to
+ * MOTORS_SNAPSHOT_READ_TRIES times.
+ *
+ * @param data Left untouched if every try was torn, so it keeps the last
+ * good copy
+ * @return true if data was updated
+ */
+bool Motors_snapshot_read(Motors_Snapshot const* snapshot,
+                          Motors_Snapshot_Data* data);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // MOTORS_SNAPSHOT_H
+
+/************************ Camilo Vera **************************END OF FILE****/
@@ -30,11 +30,28 @@ extern "C" {
 // FreeAct
 #include <FreeAct.h>
 
+// Project libraries
+#include "lcd_frame.h"
+#include "lcd_dma.h"
+
 
 /* Constants definitions -----------------------------------------------------*/
 
 #define LCD_SDA_PIN 20
 #define LCD_SCL_PIN 21
+#define LCD_I2C i2c0
+#define LCD_ADDR 0x27
+#define LCD_I2C_BAUDRATE (400 * 1000)   // PCF8574 maximum
+
+#define PRINTER_LCD_BENCHMARK 0         // Compare transfer modes at start up
+#define PRINTER_BENCHMARK_FRAMES 10     // Whole frames sent by DMA
+#define PRINTER_BENCHMARK_ROWS 20       // Rows written per mode
+
+#define PRINTER_LCD_STATS 0             // Print traffic reports
+#define PRINTER_STATS_FLUSHES 50        // Flushes between traffic reports
+
+#define PRINTER_FRAME_RATE_HZ 20        // Maximum display refresh rate
+#define PRINTER_FRAME_MS (1000 / PRINTER_FRAME_RATE_HZ)
 /* AO Class input Signals ----------------------------------------------------*/
 
 /**
@@ -44,27 +61,43 @@ extern "C" {
 
 typedef struct{
     Event super;                // Inherit from event
-    char string_buffer[20];     // Buffer
-}PRINTER_AO_TEXT_PL;
+    bool ok;                    // Display acknowledged every byte
+}PRINTER_AO_LCD_DONE_PL;
 
-#define PRINTER_AO_MAX_SIZE_EVENT PRINTER_AO_TEXT_PL
+#define PRINTER_AO_MAX_SIZE_EVENT PRINTER_AO_LCD_DONE_PL
 
 enum printer_Signals{
     PRINTER_AO_TIMEOUT_SIG = USER_SIG,  // First Signal always must replace USER_SIG
-    PRINTER_AO_TEXT0_SIG,               // Signal to print in the first row
-    PRINTER_AO_TEXT1_SIG,               // Signal to print in the second row
-    PRINTER_AO_TEXT2_SIG,               // Signal to print in the third row
-    PRINTER_AO_TEXT3_SIG                // Signal to print in the fourth row
+    PRINTER_AO_UPDATE_SIG,              // Rows waiting in the mailbox
+    PRINTER_AO_LCD_DONE_SIG             // Display transfer finished
 };
 
 
 
+/**
+ * @brief Rows are not sent as events but left in a mailbox, where a newer
+ * text for a row overlays the pending one. A single update event is queued
+ * however many rows are posted, so bursts can't overflow the queue and only
+ * the latest content is drawn.
+ */
+typedef struct{
+    char rows[LCD_ROWS][LCD_COLS + 1];  // Latest text of each row
+    uint8_t pending;                    // Rows waiting, one bit per row
+    bool posted;                        // Update event in the queue
+    uint32_t posts;                     // Rows posted
+    uint32_t coalesced;                 // Rows replaced before being drawn
+}Printer_Mailbox;
+
 /* AO Class Data -------------------------------------------------------------*/
 typedef struct {
     Active super;               // Inherit from Active Object base class
-    TimeEvent te;               // Add TimeEvent to the AO
-    /* add private data (local variables) for the AO... */
-    int var;
+    TimeEvent te;               // Frame rate timer
+    Printer_Mailbox mailbox;    // Rows posted by other AOs
+    Lcd_Frame frame;            // Shadow of the display content
+    Lcd_Dma lcd;                // Display transport
+    uint8_t stream[LCD_DMA_MAX_BYTES];  // Changes packed for the transport
+    uint16_t stream_len;
+    bool frame_armed;           // A frame was drawn in this frame slot
 }Printer;
 
 
@@ -93,11 +126,44 @@ static void Printer_dispatch(Printer * const this,
 void Printer_ctor(Printer * const this);
 
 
+/* AO Class public methods ---------------------------------------------------*/
+/**
+ * @brief Replace the content of a row from column 0, up to the end of text
+ * or LCD_COLS characters. Safe from any task, never blocks.
+ *
+ * @param printer Printer AO
+ * @param row 0..LCD_ROWS-1
+ * @param text Characters to show
+ */
+void Printer_post_row(Active * const printer, uint8_t row, char const* text);
 
-/* AO Class methods ----------------------------------------------------------*/
+/**
+ * @brief Replace several rows at once, they are drawn in the same flush
+ *
+ * @param printer Printer AO
+ * @param rows Text of each row, NULL leaves the row as it is
+ */
+void Printer_post_frame(Active * const printer, 
+                        char const* const rows[LCD_ROWS]);
 
 
 
+/* AO Class methods ----------------------------------------------------------*/
+static void Printer_render(Printer * const this);
+static void Printer_flush(Printer * const this);
+static void Printer_take_mailbox(Printer * const this);
+static bool mailbox_put(Printer_Mailbox* mailbox, uint8_t row, 
+                        char const* text);
+static void mailbox_notify(Printer * const this, bool notify);
+static void Printer_write(void* context, uint8_t row, uint8_t col,
+                          uint8_t const* data, uint8_t len);
+static void lcd_transfer_done(void* context, bool ok);
+#if PRINTER_LCD_BENCHMARK
+static void Printer_benchmark(void);
+static void Printer_benchmark_dma(Printer * const this);
+#endif
+
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,69 @@
+/**
+  ******************************************************************************
+  * @file    text_format.h
+  * @author  Camilo Vera
+  * @brief   Text formatting
+  *          Integer and tenth of degree formatting written straight into the
+  *          20 character rows of the display, without sprintf or allocation.
+  ******************************************************************************
+*/
+
+#ifndef TEXT_FORMAT_H
+#define TEXT_FORMAT_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+
+// Standard C libraries
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Constants definitions -----------------------------------------------------*/
+
+#define TEXT_ROW_LEN 20                 // Characters in a display row
+#define TEXT_INT_MAX 12                 // "-2147483648" and the terminator
+
+/* Functions -----------------------------------------------------------------*/
+
+/**
+ * @brief Write a signed integer in decimal
+ *
+ * @param buffer At least TEXT_INT_MAX characters, terminated
+ * @return Characters written, without the terminator
+ */
+uint8_t Text_format_int(char* buffer, int32_t value);
+
+/**
+ * @brief Write tenths of degree with one decimal, as in "-12.5"
+ *
+ * @param buffer At least TEXT_INT_MAX + 1 characters, terminated
+ * @return Characters written, without the terminator
+ */
+uint8_t Text_format_deg10(char* buffer, int32_t deg10);
+
+/**
+ * @brief Copy text into a row from col, then fill the rest of the row with
+ * spaces. Text that doesn't fit is clipped, the row isn't terminated.
+ */
+void Text_put(char* row, uint8_t col, char const* text);
+
+/**
+ * @brief Text_put() of a signed integer
+ */
+void Text_put_int(char* row, uint8_t col, int32_t value);
+
+/**
+ * @brief Text_put() of tenths of degree
+ */
+void Text_put_deg10(char* row, uint8_t col, int32_t deg10);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // TEXT_FORMAT_H
+
+/************************ Camilo Vera **************************END OF FILE****/
@@ -0,0 +1,100 @@
+/**
+  ******************************************************************************
+  * @file    ui_script.h
+  * @author  Camilo Vera
+  * @brief   Scripted UI runner
+  *          Feeds the UI AO a script of button presses and motor answers,
+  *          checks the screen left in the printer mailbox and measures the
+  *          dispatch time. Runs before the scheduler starts, with the UI
+  *          timers expired in virtual time, so no buttons or display are
+  *          needed.
+  ******************************************************************************
+*/
+
+#ifndef UI_SCRIPT_H
+#define UI_SCRIPT_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+
+// Standard C libraries
+#include <stdint.h>
+#include <stdbool.h>
+
+// FreeAct
+#include <FreeAct.h>
+
+// Project libraries
+#include "UI_AO.h"
+#include "printer_AO.h"
+
+/* Constants definitions -----------------------------------------------------*/
+
+#define UI_SCRIPT_RUNNER 0              // Run the script instead of the AOs
+#define UI_SCRIPT_TIMEOUTS 8            // UI timer expirations per step
+
+/* Types ---------------------------------------------------------------------*/
+
+typedef enum{
+    UI_SCRIPT_POST,                     // Post sig count times
+    UI_SCRIPT_PROGRESS,                 // Post a plan progress
+    UI_SCRIPT_EXPECT,                   // Row must start with text
+    UI_SCRIPT_END
+}UI_Script_Action;
+
+typedef struct{
+    uint8_t action;                     // UI_Script_Action
+    uint8_t row;                        // EXPECT: row, PROGRESS: phase
+    uint16_t count;                     // POST: repetitions, PROGRESS: rep
+    Signal sig;                         // POST
+    int32_t value;                      // PROGRESS: target or duration
+    char const* text;                   // EXPECT
+}UI_Script_Step;
+
+#define UI_SCRIPT_PRESS(sig, count) {UI_SCRIPT_POST, 0, (count), (sig), 0, NULL}
+#define UI_SCRIPT_PLAN(phase, rep, value) \
+    {UI_SCRIPT_PROGRESS, (phase), (rep), 0, (value), NULL}
+#define UI_SCRIPT_SCREEN(row, text) {UI_SCRIPT_EXPECT, (row), 0, 0, 0, (text)}
+#define UI_SCRIPT_DONE {UI_SCRIPT_END, 0, 0, 0, 0, NULL}
+
+typedef struct{
+    uint32_t events;                    // Dispatched, timeouts included
+    uint32_t total_us;
+    uint32_t max_us;                    // Worst dispatch
+    Signal max_sig;                     // Signal of the worst dispatch
+    uint16_t checks;
+    uint16_t failures;
+}UI_Script_Result;
+
+/* Variables -----------------------------------------------------------------*/
+
+// Menus, a routine of one exercise and its plan progress
+extern const UI_Script_Step ui_script_default[];
+
+/* Functions -----------------------------------------------------------------*/
+
+/**
+ * @brief Run a script on a constructed and started UI. Motor commands are
+ * discarded, the screen is read from the printer mailbox, so neither task
+ * may be running.
+ *
+ * @return true if every check passed
+ */
+bool UI_script_run(UI * const ui, Printer const * const printer,
+                   UI_Script_Step const* script, UI_Script_Result* result);
+
+/**
+ * @brief Print the throughput and the worst dispatch of a run
+ */
+void UI_script_report(UI_Script_Result const* result);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // UI_SCRIPT_H
+
+/************************ Camilo Vera **************************END OF FILE****/
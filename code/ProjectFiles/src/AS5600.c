@@ -20,6 +20,13 @@
 // SDK Libraries
 #include "pico/stdlib.h"
 #include "hardware/i2c.h"
+#include "hardware/dma.h"
+#include "hardware/irq.h"
+
+// Bus served by the DMA completion and I2C abort interrupts
+static AS5600_Bus* dma_bus = NULL;
+
+static void AS5600_Bus_stop(AS5600_Bus* this);
 
 
 static void read_register(i2c_inst_t* i2c_instance, 
@@ -30,7 +37,7 @@ static void read_register(i2c_inst_t* i2c_instance,
 
     i2c_write_timeout_us(i2c_instance,device_addr,&register_address,1,false,500);
     
-    i2c_read_timeout_us(i2c_instance,device_address,read_buffer,size,false,500);
+    i2c_read_timeout_us(i2c_instance,device_addr,read_buffer,size,false,500);
 }
 
 uint16_t AS5600_read_angle(i2c_inst_t* i2c){
@@ -57,7 +64,226 @@ void AS5600_config_pins(uint32_t sda_pin, uint32_t scl_pin){
 
 void AS5600_free_pins(uint32_t sda_pin, uint32_t scl_pin){
     
-    gpio_set_function(sda_pin, GPIO_FUNC_SPI);
-    gpio_set_function(scl_pin, GPIO_FUNC_SPI);
+    // Disconnect the pins, the pull ups keep the idle bus high
+    gpio_set_function(sda_pin, GPIO_FUNC_NULL);
+    gpio_set_function(scl_pin, GPIO_FUNC_NULL);
+
+}
+
+/* Encoder bus ---------------------------------------------------------------*/
+
+void AS5600_Bus_ctor(AS5600_Bus* this, i2c_inst_t* i2c, uint32_t baudrate){
+    this->i2c = i2c;
+    this->num_encoders = 0;
+    this->selected = AS5600_BUS_NO_ENCODER;
+    this->last_read_us = 0;
+    this->max_read_us = 0;
+
+    this->tx_dma = -1;
+    this->rx_dma = -1;
+    this->busy = false;
+    this->pending_encoder = 0;
+    this->start_us = 0;
+    this->timeouts = 0;
+    this->aborts = 0;
+    this->callback = NULL;
+    this->context = NULL;
+
+    i2c_init(this->i2c, baudrate);
+}
+
+uint8_t AS5600_Bus_add(AS5600_Bus* this, uint32_t sda_pin, uint32_t scl_pin){
+    assert(this->num_encoders < AS5600_BUS_MAX_ENCODERS);
+
+    uint8_t encoder = this->num_encoders;
+    this->encoders[encoder].sda_pin = sda_pin;
+    this->encoders[encoder].scl_pin = scl_pin;
+    this->num_encoders++;
+
+    AS5600_config_pull_up(sda_pin, scl_pin);
+    AS5600_free_pins(sda_pin, scl_pin);
+
+    return encoder;
+}
+
+void AS5600_Bus_select(AS5600_Bus* this, uint8_t encoder){
+    if(this->selected == encoder){
+        return;
+    }
+    if(this->selected != AS5600_BUS_NO_ENCODER){
+        AS5600_free_pins(this->encoders[this->selected].sda_pin,
+                         this->encoders[this->selected].scl_pin);
+    }
+    AS5600_config_pins(this->encoders[encoder].sda_pin,
+                       this->encoders[encoder].scl_pin);
+    this->selected = encoder;
+}
+
+static void AS5600_Bus_record_time(AS5600_Bus* this, uint32_t start){
+    this->last_read_us = time_us_32() - start;
+    if(this->last_read_us > this->max_read_us){
+        this->max_read_us = this->last_read_us;
+    }
+}
+
+// Wait for a pending asynchronous transfer, aborting it if it got stuck
+static void AS5600_Bus_wait_idle(AS5600_Bus* this){
+    while(this->busy){
+        if(time_us_32() - this->start_us > AS5600_ASYNC_TIMEOUT_US){
+            AS5600_Bus_abort(this);
+        }
+        tight_loop_contents();
+    }
+}
+
+uint16_t AS5600_Bus_read_angle(AS5600_Bus* this, uint8_t encoder){
+    AS5600_Bus_wait_idle(this);
+    uint32_t start = time_us_32();
+
+    AS5600_Bus_select(this, encoder);
+    uint16_t reading = AS5600_read_angle(this->i2c);
+
+    AS5600_Bus_record_time(this, start);
+    return reading;
+}
+
+/* Asynchronous reads --------------------------------------------------------*/
+
+static void AS5600_dma_irq_handler(void){
+    AS5600_Bus* this = dma_bus;
+    if(this == NULL || !dma_channel_get_irq0_status(this->rx_dma)){
+        return;     // Shared interrupt, not ours
+    }
+    dma_channel_acknowledge_irq0(this->rx_dma);
+
+    i2c_get_hw(this->i2c)->intr_mask = 0;
+    uint16_t angle = (this->rx_data[0] << 8) + this->rx_data[1];
+    AS5600_Bus_record_time(this, this->start_us);
+    this->busy = false;
+
+    if(this->callback != NULL){
+        this->callback(this->context, this->pending_encoder, angle, true);
+    }
+}
+
+// Release the DMA channels and the controller from a transfer
+static void AS5600_Bus_stop(AS5600_Bus* this){
+    i2c_get_hw(this->i2c)->intr_mask = 0;
+    dma_channel_abort(this->tx_dma);
+    dma_channel_abort(this->rx_dma);
+    dma_channel_acknowledge_irq0(this->rx_dma);
+
+    // Reading the register clears the abort and flushes the FIFOs
+    (void)i2c_get_hw(this->i2c)->clr_tx_abrt;
+
+    this->busy = false;
+}
+
+// A NACK or lost arbitration stops the controller, the read never completes
+static void AS5600_i2c_irq_handler(void){
+    AS5600_Bus* this = dma_bus;
+    i2c_hw_t* hw = i2c_get_hw(this->i2c);
+
+    if(!(hw->intr_stat & I2C_IC_INTR_STAT_R_TX_ABRT_BITS)){
+        return;
+    }
+    hw->intr_mask = 0;
+    if(!this->busy){
+        return;
+    }
+    AS5600_Bus_stop(this);
+    this->aborts++;
+
+    if(this->callback != NULL){
+        this->callback(this->context, this->pending_encoder, 0, false);
+    }
+}
+
+static uint AS5600_i2c_irq(AS5600_Bus const* this){
+    return i2c_hw_index(this->i2c) == 0 ? I2C0_IRQ : I2C1_IRQ;
+}
+
+void AS5600_Bus_dma_init(AS5600_Bus* this, AS5600_Callback callback,
+                         void* context){
+    i2c_hw_t* hw = i2c_get_hw(this->i2c);
+
+    this->callback = callback;
+    this->context = context;
+    this->tx_dma = dma_claim_unused_channel(true);
+    this->rx_dma = dma_claim_unused_channel(true);
+
+    // Commands are pushed to DATA_CMD as the TX FIFO drains
+    dma_channel_config tx_config = dma_channel_get_default_config(this->tx_dma);
+    channel_config_set_transfer_data_size(&tx_config, DMA_SIZE_16);
+    channel_config_set_read_increment(&tx_config, true);
+    channel_config_set_write_increment(&tx_config, false);
+    channel_config_set_dreq(&tx_config, i2c_get_dreq(this->i2c, true));
+    dma_channel_configure(this->tx_dma, &tx_config, &hw->data_cmd,
+                          this->tx_cmds, 3, false);
+
+    // Received bytes are popped from DATA_CMD as they arrive
+    dma_channel_config rx_config = dma_channel_get_default_config(this->rx_dma);
+    channel_config_set_transfer_data_size(&rx_config, DMA_SIZE_8);
+    channel_config_set_read_increment(&rx_config, false);
+    channel_config_set_write_increment(&rx_config, true);
+    channel_config_set_dreq(&rx_config, i2c_get_dreq(this->i2c, false));
+    dma_channel_configure(this->rx_dma, &rx_config, this->rx_data,
+                          &hw->data_cmd, 2, false);
+
+    dma_bus = this;
+    dma_channel_set_irq0_enabled(this->rx_dma, true);
+    irq_add_shared_handler(AS5600_DMA_IRQ, AS5600_dma_irq_handler,
+                           PICO_SHARED_IRQ_HANDLER_DEFAULT_ORDER_PRIORITY);
+    irq_set_enabled(AS5600_DMA_IRQ, true);
+
+    // Unmasked only while a transfer runs
+    hw->intr_mask = 0;
+    irq_set_exclusive_handler(AS5600_i2c_irq(this), AS5600_i2c_irq_handler);
+    irq_set_enabled(AS5600_i2c_irq(this), true);
+}
+
+/**
+ * @brief Start a raw angle read and return immediately, the callback is 
+ * executed from the DMA interrupt when both bytes have been received, or
+ * from the I2C interrupt with ok false if the controller aborts the transfer.
+ * A transfer that neither completes nor aborts is only cleared by the next
+ * read, callers waiting for the callback need their own timeout.
+ *
+ * @return false if another transfer is still in flight
+ */
+bool AS5600_Bus_read_angle_async(AS5600_Bus* this, uint8_t encoder){
+    if(this->busy){
+        if(time_us_32() - this->start_us <= AS5600_ASYNC_TIMEOUT_US){
+            return false;
+        }
+        AS5600_Bus_abort(this);     // Device did not answer (NACK)
+    }
+
+    AS5600_Bus_select(this, encoder);
+
+    i2c_hw_t* hw = i2c_get_hw(this->i2c);
+    hw->enable = 0;
+    hw->tar = device_address;
+    hw->enable = 1;
+
+    // Register address write, then a repeated start read of two bytes
+    this->tx_cmds[0] = raw_angle_address;
+    this->tx_cmds[1] = I2C_IC_DATA_CMD_RESTART_BITS | I2C_IC_DATA_CMD_CMD_BITS;
+    this->tx_cmds[2] = I2C_IC_DATA_CMD_CMD_BITS | I2C_IC_DATA_CMD_STOP_BITS;
+
+    (void)hw->clr_tx_abrt;
+    hw->intr_mask = I2C_IC_INTR_MASK_M_TX_ABRT_BITS;
+
+    this->pending_encoder = encoder;
+    this->start_us = time_us_32();
+    this->busy = true;
+
+    dma_channel_transfer_to_buffer_now(this->rx_dma, this->rx_data, 2);
+    dma_channel_transfer_from_buffer_now(this->tx_dma, this->tx_cmds, 3);
+    return true;
+}
 
+void AS5600_Bus_abort(AS5600_Bus* this){
+    AS5600_Bus_stop(this);
+    this->timeouts++;
 }
@@ -15,7 +15,8 @@
 #include <stdio.h>
 #include <stdint.h>
 #include <stdbool.h>
-#include <math.h>
+#include <stdlib.h>
+#include <string.h>
 
 // SDK Libraries
 #include "pico/stdlib.h"
@@ -30,11 +31,58 @@
 // Project libraries
 #include "pio_stepper.h"
 #include "AS5600.h"
-
-int16_t offset = 0;
+#include "calib_flash.h"
+#include "fixed_point.h"
+#include "motion_tables.h"
+#include "motors_snapshot.h"
 
 #define TRIGGER_VOID_EVENT TimeEvent_arm(&this->te, (1 / portTICK_RATE_MS), 0U)
 
+// Every axis of AXIS_LIST is built from its MOTORn_ constants
+#define AXIS_CONFIG(n) {                                                       \
+    .id = AXIS_M##n,                                                           \
+    .name = "M" #n,                                                            \
+    .pio = MOTOR##n##_PIO,                                                     \
+    .sm = MOTOR##n##_PIO_SM,                                                   \
+    .dir_pin = MOTOR##n##_DIR_PIN,                                             \
+    .step_pin = MOTOR##n##_STEP_PIN,                                           \
+    .enable_pin = MOTOR##n##_ENABLE_PIN,                                       \
+    .transmission_rate = MOTOR##n##_TRANSMISSION_RATE,                         \
+    .steps_per_rev = MOTOR##n##_STEPS_PER_REV,                                 \
+    .encoder_sda = ENCODER##n##_SDA_PIN,                                       \
+    .encoder_scl = ENCODER##n##_SCL_PIN,                                       \
+    .encoder_offset = ENCODER##n##_OFFSET,                                     \
+    .encoder_pos_dir = ENCODER##n##_POS_DIR,                                   \
+    .pos_dir = MOTOR##n##_POS_DIR,                                             \
+    .neg_dir = MOTOR##n##_NEG_DIR,                                             \
+    .encoder_fix = MOTOR##n##_ENCODER_FIX,                                     \
+    .center_freq = MOTOR##n##_CENTER_FREQ,                                     \
+    .center_steps = MOTOR##n##_CENTER_STEPS,                                   \
+    .movement_freq = MOTOR##n##_MOVEMENT_FREQ,                                 \
+    .homing = {                                                                \
+        .end_switch = END_SWITCH_##n,                                          \
+        .approach_dir = MOTOR##n##_NEG_DIR,                                    \
+        .center_dir = MOTOR##n##_POS_DIR,                                      \
+        .fast_freq = MOTOR##n##_HOMING_FAST_FREQ,                              \
+        .slow_freq = MOTOR##n##_HOMING_SLOW_FREQ,                              \
+        .center_freq = MOTOR##n##_HOMING_CENTER_FREQ,                          \
+        .back_off_steps = MOTOR##n##_HOMING_BACK_OFF_STEPS,                    \
+        .max_steps = MOTOR##n##_HOMING_MAX_STEPS,                              \
+        .home_to_center_steps = MOTOR##n##_HOME_TO_CENTER_STEPS                \
+    }                                                                          \
+},
+
+static const Motors_Axis_Config axis_configs[AXIS_COUNT] = {
+    AXIS_LIST(AXIS_CONFIG)
+};
+
+Motors_Snapshot motors_snapshot;
+
+// Batch moves run through the plan executor from this copy
+static Motion_Plan batch_plan;
+// Malformed batch or AO busy, the motors are left as they are
+static const Event batch_nack = {UI_AO_NACK_MOVE_SIG};
+
 void Motors_ctor(Motors * const this){
     Active_ctor(&this->super, (DispatchHandler)&Motors_dispatch);
     
@@ -42,81 +90,134 @@ void Motors_ctor(Motors * const this){
     TimeEvent_ctor(&this->te, MOTORS_AO_TIMEOUT_SIG, &this->super);
     
     // State Machine initialization
-    this->state = MOTORS_AO_CALIB_M1_ST;
-    this->past_state = MOTORS_AO_CALIB_M1_ST;
+    this->state = MOTORS_AO_CALIB_ST;
+    this->past_state = MOTORS_AO_CALIB_ST;
     //this->state = MOTORS_AO_WAITING_ST;
     //this->past_state = MOTORS_AO_WAITING_ST;
 
-    this->center_m1_state = CENTER_M1_PENDING_ST; 
-    this->center_m2_state = CENTER_M2_PENDING_ST; 
+    this->calib_start_us = 0;
+    this->calib_requested = false;
+    this->fast_boot_reads = 0;
+    this->fast_boot_tries = 0;
+    this->center_state = CENTER_PENDING_ST;
+    this->fix_pending = false;
+
     // private data initialization
-    
+    this->axis = AXIS_M1;
     this->centering_steps = 0;
     this->movement_steps = 0;
-    this->motor1_current_position = 0;
-    this->motor2_current_position = 0;
-    this->motor1_goal_position = 0;
-    this->motor2_goal_position = 0;
     this->movement_dir = false;
     this->centering_dir = false;
-
-    this->encoder1_current_angle = 0;
-    this->encoder2_current_angle = 0;
-    this->encoder1_turns = 0;
-    this->encoder2_turns = 0;
-    this->encoder1_last_read = 0;
-    this->encoder2_last_read = 0;
-
+    this->plan = NULL;
+    this->plan_step = 0;
+    this->plan_rep_start = 0;
+    this->plan_rep = 0;
+    this->plan_in_rep = false;
+    this->plan_paused = false;
+    this->plan_batch = false;
+    this->plan_progress = true;
+
+    this->check_countdown = 0;
+    this->check_axis = AXIS_M1;
+    this->check_pending = false;
+    this->check_expected = 0;
+    this->check_count = 0;
+    this->check_us_total = 0;
+    this->check_us_max = 0;
+    this->check_resyncs = 0;
+    this->check_misses = 0;
+    this->check_missed = 0;
 
     // Init code, preferably use bsp.c defined functions to control peripheral 
     // to keep encapsulation
-    StepperMotor_ctor(&(this->motor1), pio0, 0, MOTOR1_DIR_PIN, 
-                  MOTOR1_STEP_PIN, MOTOR1_ENABLE_PIN, 400, 3);
-    StepperMotor_ctor(&(this->motor2), pio1, 0, MOTOR2_DIR_PIN, 
-                  MOTOR2_STEP_PIN, MOTOR2_ENABLE_PIN, 400, 1);
-    AS5600_i2c_init(i2c1);
-    
-
-    // End_switches
-
-    gpio_init(END_SWITCH_1);
-    gpio_init(END_SWITCH_2);
-    gpio_pull_down(END_SWITCH_1);
-    gpio_pull_down(END_SWITCH_2);
-    gpio_set_dir(END_SWITCH_1, GPIO_IN);
-    gpio_set_dir(END_SWITCH_2, GPIO_IN);
+    // Before the scheduler starts, a sector erase stalls the interrupts
+    Calib_flash_init();
 
+    AS5600_Bus_ctor(&(this->encoders), ENCODERS_I2C, ENCODERS_I2C_BAUDRATE);
+    for(uint8_t i = 0; i < AXIS_COUNT; i++){
+        Motors_Axis_ctor(&(this->axes[i]), &(this->encoders), &axis_configs[i]);
+    }
+    AS5600_Bus_dma_init(&(this->encoders), &encoder_read_done, &this->super);
 }
 
 static void Motors_dispatch(Motors * const this, 
                             Event const * const e){
+    Motors_Axis* axis = &(this->axes[this->axis]);
+
     // Initial event
     if(e->sig == INIT_SIG){
-        
-        // TRIGGER_VOID_EVENT; // Provisional to trigger state machine
-         // Do nothing and wait for external signal
+        // With a stored calibration the encoders are checked against it,
+        // otherwise wait for the UI to start homing
+        if(Calib_flash_load(&this->calib, MECHANISM_ID)){
+            this->state = MOTORS_AO_FAST_BOOT_ST;
+            this->calib_start_us = time_us_32();
+            TRIGGER_VOID_EVENT;
+        }
     }else{
 
+    // Batches are only run from WAITING, a busy AO refuses them right away
+    if(e->sig == MOTORS_AO_BATCH_SIG && this->state != MOTORS_AO_WAITING_ST){
+        Active_post(AO_UI, (Event*)&batch_nack);
+    }
+
     // State Machine 
     switch(this->state){
-        case MOTORS_AO_CALIB_M1_ST:{        // MOTOR 1 Calibration
+        case MOTORS_AO_FAST_BOOT_ST:{       // Stored calibration validation
             switch(e->sig){
-                case MOTORS_AO_START_CALIB_SIG:
-                    // Jump to next event response
-                case MOTORS_AO_TIMEOUT_SIG:{
-                    // Look for the end switch press
-                    if(!gpio_get(END_SWITCH_1)){
-                        this->past_state = MOTORS_AO_CALIB_M1_ST;
-                        this->state = MOTORS_AO_CENTER_M1_ST;
-                        this->centering_steps = MOTOR1_HOME_TO_CENTER_STEPS;
-                        this->centering_dir = MOTOR1_POS_DIR;
+                case MOTORS_AO_START_CALIB_SIG:{
+                    // Answered once the validation finishes
+                    this->calib_requested = true;
+                    break;
+                }case MOTORS_AO_TIMEOUT_SIG:{
+                    // Every read gets a deadline, a lost one is issued again
+                    if(this->fast_boot_tries++ >= FAST_BOOT_READ_TRIES){
+                        fast_boot_reject(this, "encoder not answering");
+                        break;
+                    }
+                    read_encoder(this, this->fast_boot_reads);
+                    TimeEvent_arm(&this->te, 
+                                  (FAST_BOOT_READ_TIMEOUT_MS / portTICK_RATE_MS), 0U);
+                    break;
+                }case MOTORS_AO_ENCODER_READ_SIG:{
+                    Motors_Axis* read_axis = 
+                            encoder_axis(this, ((MOTORS_AO_ENCODER_PL*)e)->encoder);
+                    if(read_axis != &(this->axes[this->fast_boot_reads])){
+                        break;
+                    }
+                    if(!((MOTORS_AO_ENCODER_PL*)e)->ok){
+                        TRIGGER_VOID_EVENT;     // Read it again
+                        break;
+                    }
+                    read_axis->encoder_last_read = ((MOTORS_AO_ENCODER_PL*)e)->angle 
+                                                   + read_axis->config->encoder_offset;
+                    this->fast_boot_tries = 0;
+                    if(++this->fast_boot_reads < AXIS_COUNT){
                         TRIGGER_VOID_EVENT;
+                        break;
+                    }
 
-                    }else{
+                    bool calib_valid = true;
+                    for(uint8_t i = 0; i < AXIS_COUNT; i++){
+                        calib_valid = calib_valid &&
+                            calib_matches(this->axes[i].encoder_last_read, 
+                                          this->calib.encoder_zero[i]) &&
+                            gpio_get(axis_configs[i].homing.end_switch);
+                    }
 
-                        TimeEvent_arm(&this->te, (10 / portTICK_RATE_MS), 0U);
-                        StepperMotor_move(&(this->motor1), MOTOR1_NEG_DIR,
-                                        MOTOR1_CALIB_FREQ, MOTOR1_CALIB_STEPS);
+                    if(calib_valid){
+                        TimeEvent_disarm(&this->te);
+                        for(uint8_t i = 0; i < AXIS_COUNT; i++){
+                            this->axes[i].encoder_zero = this->calib.encoder_zero[i];
+                            this->axes[i].homing.zeroed = true;
+                        }
+                        printf("Stored calibration accepted in %lu us\n",
+                               time_us_32() - this->calib_start_us);
+                        static const Event calibration_ack = {UI_AO_ACK_CALIB_SIG};
+                        Active_post(AO_UI, (Event*)&calibration_ack);
+                        this->state = MOTORS_AO_WAITING_ST;
+                        this->past_state = MOTORS_AO_FAST_BOOT_ST;
+                    }else{
+                        fast_boot_reject(this, "encoders moved");
                     }
                     break;
                 }default:
@@ -124,318 +225,184 @@ static void Motors_dispatch(Motors * const this,
             }
             break;
 
-        }case MOTORS_AO_CENTER_M1_ST:{      // MOTOR 1 Centering
+        }case MOTORS_AO_CALIB_ST:{          // All motors calibration
             switch(e->sig){
+                case MOTORS_AO_START_CALIB_SIG:
+                    this->calib_start_us = time_us_32();
+                    // Jump to next event response
                 case MOTORS_AO_TIMEOUT_SIG:{
-                    if(this->center_m1_state == CENTER_M1_PENDING_ST){
-                        if(this->centering_steps < MOTOR1_CENTER_STEPS){
-                            if(this->centering_steps != 0){
-                                StepperMotor_move(&(this->motor1), this->centering_dir,
-                                        MOTOR1_CENTER_FREQ, this->centering_steps);
-                            }
-                            this->centering_steps = 0;
-                            this->center_m1_state = CENTER_M1_DONE_ST;
-                            TimeEvent_arm(&this->te, (100 / portTICK_RATE_MS), 0U);
-
-                        }else{
-                            TimeEvent_arm(&this->te, (10 / portTICK_RATE_MS), 0U);
-                            StepperMotor_move(&(this->motor1), this->centering_dir,
-                                        MOTOR1_CENTER_FREQ, MOTOR1_CENTER_STEPS);
-                            this->centering_steps-=MOTOR1_CENTER_STEPS;
-                        }
-
-                    }else if(this->center_m1_state == CENTER_M1_DONE_ST){
-                        if(this->past_state == MOTORS_AO_CALIB_M1_ST){
-                            this->encoder1_zero = read_encoder1();
-                            this->encoder1_last_read = this->encoder1_zero;
-                            this->state = MOTORS_AO_CALIB_M2_ST;
-                        }else{
-                            this->state = MOTORS_AO_WAITING_ST;
+                    // All axes are homed concurrently
+                    Motors_Axis* zero_pending = NULL;
+                    bool failed = false;
+
+                    for(uint8_t i = 0; i < AXIS_COUNT && !failed; i++){
+                        Motors_AO_Homing_state homing_state = 
+                                    Motors_Homing_run(&(this->axes[i].homing));
+                        if(homing_state == HOMING_ERROR_ST){
+                            motors_error(this, &(this->axes[i]), "home not found");
+                            failed = true;
+                        }else if(homing_state == HOMING_DONE_ST && 
+                                 !this->axes[i].homing.zeroed && 
+                                 zero_pending == NULL){
+                            zero_pending = &(this->axes[i]);
                         }
-                        this->past_state = MOTORS_AO_CENTER_M1_ST;
-                        TRIGGER_VOID_EVENT;
+                    }
+                    if(failed){
+                        break;
+                    }
 
+                    // Zeros are captured when the readings arrive, one at a
+                    // time on the shared bus
+                    if(zero_pending != NULL){
+                        read_encoder(this, zero_pending->config->id);
                     }
+                    TimeEvent_arm(&this->te, (HOMING_POLL_MS / portTICK_RATE_MS), 0U);
                     break;
-                }default:
-                    break;
-            }
-            break;
-        }case MOTORS_AO_CALIB_M2_ST:{
-            switch(e->sig){
-                case MOTORS_AO_START_CALIB_SIG:
-                    // Jump to next event response
-                case MOTORS_AO_TIMEOUT_SIG:{
-                    // Look for the end switch press
-                    if(!gpio_get(END_SWITCH_2)){
-                        this->past_state = MOTORS_AO_CALIB_M2_ST;
-                        this->state = MOTORS_AO_CENTER_M2_ST;
-                        this->centering_steps = MOTOR2_HOME_TO_CENTER_STEPS;
-                        this->centering_dir = MOTOR2_POS_DIR;
-                        TRIGGER_VOID_EVENT;
+                }case MOTORS_AO_ENCODER_READ_SIG:{
+                    Motors_Axis* read_axis = 
+                            encoder_axis(this, ((MOTORS_AO_ENCODER_PL*)e)->encoder);
+                    // A failed read is issued again by the next poll
+                    if(read_axis == NULL || !((MOTORS_AO_ENCODER_PL*)e)->ok){
+                        break;
+                    }
+                    read_axis->encoder_zero = ((MOTORS_AO_ENCODER_PL*)e)->angle 
+                                              + read_axis->config->encoder_offset;
+                    read_axis->encoder_last_read = read_axis->encoder_zero;
+                    read_axis->homing.zeroed = true;
+
+                    bool all_zeroed = true;
+                    for(uint8_t i = 0; i < AXIS_COUNT; i++){
+                        all_zeroed = all_zeroed && this->axes[i].homing.zeroed;
+                    }
 
-                    }else{
+                    if(all_zeroed){
+                        TimeEvent_disarm(&this->te);
+                        for(uint8_t i = 0; i < AXIS_COUNT; i++){
+                            printf("Homing %s: %lu ms\n", axis_configs[i].name,
+                                   this->axes[i].homing.time_ms);
+                        }
+                        printf("Homing total: %lu ms\n",
+                               (time_us_32() - this->calib_start_us) / 1000);
+                        printf("Encoder read: %lu us, worst %lu us\n",
+                               this->encoders.last_read_us,
+                               this->encoders.max_read_us);
+                        static const Event calibration_ack = {UI_AO_ACK_CALIB_SIG};
+                        Active_post(AO_UI, (Event*)&calibration_ack);
+                        this->state = MOTORS_AO_WAITING_ST;
+                        this->past_state = MOTORS_AO_CALIB_ST;
 
-                        TimeEvent_arm(&this->te, (10 / portTICK_RATE_MS), 0U);
-                        StepperMotor_move(&(this->motor2), MOTOR2_NEG_DIR,
-                                        MOTOR2_CALIB_FREQ, MOTOR2_CALIB_STEPS);
+                        // Skip homing on the next boot if nothing moves
+                        this->calib.mechanism_id = MECHANISM_ID;
+                        for(uint8_t i = 0; i < AXIS_COUNT; i++){
+                            this->calib.encoder_zero[i] = this->axes[i].encoder_zero;
+                        }
+                        if(Calib_flash_save(&this->calib)){
+                            printf("Calibration stored\n");
+                        }
                     }
                     break;
                 }default:
                     break;
             }
             break;
- 
-        }case MOTORS_AO_CENTER_M2_ST:{
+
+        }case MOTORS_AO_CENTER_ST:{         // Selected axis centering
             switch(e->sig){
                 case MOTORS_AO_TIMEOUT_SIG:{
-                    if(this->center_m2_state == CENTER_M2_PENDING_ST){
-                        if(this->centering_steps < MOTOR2_CENTER_STEPS){
+                    const Motors_Axis_Config* config = axis->config;
+
+                    if(this->center_state == CENTER_PENDING_ST){
+                        if(this->centering_steps < config->center_steps){
                             if(this->centering_steps != 0){
-                                StepperMotor_move(&(this->motor2), this->centering_dir,
-                                        MOTOR2_CENTER_FREQ, this->centering_steps);
+                                StepperMotor_move(&(axis->motor), this->centering_dir,
+                                        config->center_freq, this->centering_steps);
                             }
                             this->centering_steps = 0;
-                            this->center_m2_state = CENTER_M2_DONE_ST;
+                            this->center_state = CENTER_DONE_ST;
                             TimeEvent_arm(&this->te, (100 / portTICK_RATE_MS), 0U);
 
                         }else{
                             TimeEvent_arm(&this->te, (10 / portTICK_RATE_MS), 0U);
-                            StepperMotor_move(&(this->motor2), this->centering_dir,
-                                        MOTOR2_CENTER_FREQ, MOTOR2_CENTER_STEPS);
-                            this->centering_steps-=MOTOR2_CENTER_STEPS;
+                            StepperMotor_move(&(axis->motor), this->centering_dir,
+                                        config->center_freq, config->center_steps);
+                            this->centering_steps-=config->center_steps;
                         }
 
-                    }else if(this->center_m2_state == CENTER_M2_DONE_ST){
-                        if(this->past_state == MOTORS_AO_CALIB_M2_ST){
-                            this->encoder2_zero = read_encoder2() + offset;
-                            this->encoder2_last_read = this->encoder2_zero;
-                            static const Event calibration_ack = {UI_AO_ACK_CALIB_SIG};
-                            Active_post(AO_UI, (Event*)&calibration_ack);
-                            this->state = MOTORS_AO_WAITING_ST;
-                        }else{
-                            this->state = MOTORS_AO_CENTER_M2_FREE_FIX_ST;
-                        }
-
-                        this->past_state = MOTORS_AO_CENTER_M2_ST;
+                    }else if(this->center_state == CENTER_DONE_ST){
+                        this->fix_pending = false;
+                        this->state = config->encoder_fix ? 
+                                      MOTORS_AO_CENTER_FIX_ST : MOTORS_AO_WAITING_ST;
+                        this->past_state = MOTORS_AO_CENTER_ST;
                         TRIGGER_VOID_EVENT;
-
                     }
                     break;
                 }default:
                     break;
             }
             break;
-        }case MOTORS_AO_FREE_M1_ST:{
+        }case MOTORS_AO_FREE_ST:{
             switch(e->sig){
                 case MOTORS_AO_TIMEOUT_SIG:{
-                    StepperMotor_disable(&(this->motor1));
-
-                    uint16_t encoder1_current_read = read_encoder1();
-
-                    #if ENCODER1_POS_DIR == 0
-
-                        // Identify overflow
-                        if(encoder1_current_read  >= 0 && 
-                           encoder1_current_read < 500 && 
-                           this->encoder1_last_read <= 4095 &&
-                           this->encoder1_last_read > 3595){
-
-                            this->encoder1_turns++;
-                            
-                        }else if(encoder1_current_read  <= 4095 && 
-                                encoder1_current_read > 3595 && 
-                                this->encoder1_last_read >= 0 &&
-                                this->encoder1_last_read < 500){
-                            this->encoder1_turns--;
-
-                        }
-                        this->encoder1_current_angle = (int32_t)(3600
-                            *(((float)(4095-encoder1_current_read)) 
-                            +((float)(this->encoder1_turns*4096))
-                            -((float)(4095-this->encoder1_zero))))
-                            /(4096*MOTOR1_TRANSMISSION_RATE);
-
-
-                        this->encoder1_current_angle = 10*MOTOR1_DEG_PER_STEP*
-                            ((float)encoder1_current_read) 
-                            +((float)(this->encoder1_turns*4096))
-                            -((float)this->encoder1_zero);
-                    #elif ENCODER1_POS_DIR == 1
-                        // Identify overflow
-                        if(encoder1_current_read  >= 0 && 
-                           encoder1_current_read < 500 && 
-                           this->encoder1_last_read <= 4095 &&
-                           this->encoder1_last_read > 3595){
-
-                            this->encoder1_turns--;
-                            
-                        }else if(encoder1_current_read  <= 4095 && 
-                                encoder1_current_read > 3595 && 
-                                this->encoder1_last_read >= 0 &&
-                                this->encoder1_last_read < 500){
-                            this->encoder1_turns++;
-
-                        }
-
-                        this->encoder1_current_angle = (int32_t)(3600
-                            *(((float)(4095-encoder1_current_read)) 
-                            +((float)(this->encoder1_turns*4096))
-                            -((float)(4095-this->encoder1_zero))))
-                            /(4096*MOTOR1_TRANSMISSION_RATE);
-                            
-
-                    #endif
-
-                    this->encoder1_last_read = encoder1_current_read;
+                    StepperMotor_disable(&(axis->motor));
+                    read_encoder(this, this->axis);
                     TimeEvent_arm(&this->te, (10 / portTICK_RATE_MS), 0U);
                     break;
-                }case MOTORS_AO_RQ_DEG_M1_SIG:{
-                    static UI_AO_ANGLE_PL angle1_ack = {UI_AO_ACK_DEG_M1_SIG};
-                    angle1_ack.angle = this->encoder1_current_angle;
-                    Active_post(AO_UI, (Event*)&angle1_ack);
-
+                }case MOTORS_AO_ENCODER_READ_SIG:{
+                    if(encoder_axis(this, ((MOTORS_AO_ENCODER_PL*)e)->encoder) != axis ||
+                       !((MOTORS_AO_ENCODER_PL*)e)->ok){
+                        break;
+                    }
+                    Motors_Axis_update_angle(axis, ((MOTORS_AO_ENCODER_PL*)e)->angle);
                     break;
-                }case MOTORS_AO_BLOCK_M1_SIG:{
-                    StepperMotor_enable(&(this->motor1));
-                    this->past_state = MOTORS_AO_FREE_M1_ST;
-                    this->state = MOTORS_AO_CENTER_M1_ST;
-                    this->center_m1_state = CENTER_M1_PENDING_ST;
-                    
-                    
-                    if(this->encoder1_current_angle<0){
-                        this->centering_dir = MOTOR1_POS_DIR;
-
-                        this->centering_steps = (uint16_t) 
-                                                ((-this->encoder1_current_angle
-                                                *MOTOR1_TRANSMISSION_RATE
-                                                *MOTOR1_STEPS_PER_REV)/3600);
-                    }else{
-                        this->centering_dir = MOTOR1_NEG_DIR;
-
-                        this->centering_steps = (uint16_t) 
-                                                ((this->encoder1_current_angle
-                                                *MOTOR1_TRANSMISSION_RATE
-                                                *MOTOR1_STEPS_PER_REV)/3600);
+                }case MOTORS_AO_BLOCK_M1_SIG:
+                case MOTORS_AO_BLOCK_M2_SIG:{
+                    if(signal_axis(e->sig) != this->axis){
+                        break;
                     }
-
-                    
+                    StepperMotor_enable(&(axis->motor));
+                    this->past_state = MOTORS_AO_FREE_ST;
+                    this->state = MOTORS_AO_CENTER_ST;
+                    Motors_Axis_start_centering(this);
                     TRIGGER_VOID_EVENT;
-
-
-                }
-                default:
+                    break;
+                }default:
                     break;
             }
             break;
-        
-        }case MOTORS_AO_FREE_M2_ST:{
+        }
+        case MOTORS_AO_CENTER_FIX_ST:{
             switch(e->sig){
                 case MOTORS_AO_TIMEOUT_SIG:{
-                    StepperMotor_disable(&(this->motor2));
-
-                    uint16_t encoder2_current_read = read_encoder2() + offset;
-                        // Identify overflow
-                    if(encoder2_current_read  >= 0 && 
-                       encoder2_current_read < 500 && 
-                       this->encoder2_last_read <= 4095 &&
-                       this->encoder2_last_read > 3595){
-                        this->encoder2_turns++;
-                        
-                    }else if(encoder2_current_read  <= 4095 && 
-                            encoder2_current_read > 3595 && 
-                            this->encoder2_last_read >= 0 &&
-                            this->encoder2_last_read < 500){
-                        this->encoder2_turns--;
+                    // The poll never waits on a read, a lost one is issued again
+                    if(read_encoder(this, this->axis)){
+                        this->fix_pending = true;
                     }
-                    #if ENCODER2_POS_DIR == 0
-
-                    float value = (3600
-                            *(((float)(encoder2_current_read)) 
-                            //+((float)(this->encoder2_turns*4096))
-                            -((float)(this->encoder2_zero))))
-                            /(4096*MOTOR2_TRANSMISSION_RATE);
-
-                    this->encoder2_current_angle = (int32_t)value;
-
-
-
-                    #elif ENCODER2_POS_DIR == 1
-
-
-                        this->encoder2_current_angle = -((int32_t)(3600
-                            *(((float)(4095-encoder2_current_read)) 
-                            +((float)(this->encoder2_turns*4096))
-                            -((float)(4095-this->encoder2_zero))))
-                            /(4096*MOTOR2_TRANSMISSION_RATE));
-                            
-
-                    #endif
-
-                    this->encoder2_last_read = encoder2_current_read;
                     TimeEvent_arm(&this->te, (10 / portTICK_RATE_MS), 0U);
                     break;
-
-                }case MOTORS_AO_RQ_DEG_M2_SIG:{
-                    static UI_AO_ANGLE_PL angle2_ack = {UI_AO_ACK_DEG_M2_SIG};
-                    angle2_ack.angle = this->encoder2_current_angle;
-                    Active_post(AO_UI, (Event*)&angle2_ack);
-
-                    break;
-                }case MOTORS_AO_BLOCK_M2_SIG:{
-                    StepperMotor_enable(&(this->motor2));
-                    this->past_state = MOTORS_AO_FREE_M2_ST;
-                    this->state = MOTORS_AO_CENTER_M2_ST;
-                    this->center_m2_state = CENTER_M2_PENDING_ST;
-
-
-                    if(this->encoder2_current_angle<0){
-                        this->centering_dir = MOTOR2_POS_DIR;
-
-                        this->centering_steps = (uint16_t) 
-                                                ((-(this->encoder2_current_angle)
-                                                *(MOTOR2_TRANSMISSION_RATE)
-                                                *MOTOR2_STEPS_PER_REV)/3600);
-                    }else{
-                        this->centering_dir = MOTOR2_NEG_DIR;
-
-                        this->centering_steps = (uint16_t) 
-                                                ((this->encoder2_current_angle
-                                                *MOTOR2_TRANSMISSION_RATE
-                                                *MOTOR2_STEPS_PER_REV)/3600);
+                }case MOTORS_AO_ENCODER_READ_SIG:{
+                    // Only the answer to the last read issued counts
+                    if(!this->fix_pending ||
+                       encoder_axis(this, ((MOTORS_AO_ENCODER_PL*)e)->encoder) != axis){
+                        break;
                     }
-
-                    
-                    TRIGGER_VOID_EVENT;
-
-
-                }
-                default:
-                    break;
-            }
-            break;
-        }
-        case MOTORS_AO_CENTER_M2_FREE_FIX_ST:{
-            switch(e->sig){
-                case MOTORS_AO_TIMEOUT_SIG:{
-                    uint16_t read_encoder2_value = read_encoder2() + offset;
-                    if(fabs(read_encoder2_value- this->encoder2_zero)>15 &&
-                        fabs(read_encoder2_value - this->encoder2_zero)<200) {
-                            if(read_encoder2_value<this->encoder2_zero){
-
-                                StepperMotor_move(&(this->motor2), false,
-                                                    MOTOR2_CENTER_FREQ, 1);
-                            }else{
-                                StepperMotor_move(&(this->motor2), true,
-                                                    MOTOR2_CENTER_FREQ, 1);
-
-                            }
-                        
-                        TimeEvent_arm(&this->te, (10 / portTICK_RATE_MS), 0U);
+                    this->fix_pending = false;
+                    if(!((MOTORS_AO_ENCODER_PL*)e)->ok){
+                        break;
+                    }
+                    int32_t encoder_error = (int32_t)(((MOTORS_AO_ENCODER_PL*)e)->angle
+                                            + axis->config->encoder_offset)
+                                            - (int32_t)axis->encoder_zero;
+                    if(axis->config->encoder_pos_dir){
+                        encoder_error = -encoder_error;
+                    }
+                    if(abs(encoder_error)>15 && abs(encoder_error)<200) {
+                        StepperMotor_move(&(axis->motor), encoder_error<0 ? 
+                                          axis->config->pos_dir : axis->config->neg_dir,
+                                          axis->config->center_freq, 1);
 
                     }else{
                         this->state = MOTORS_AO_WAITING_ST;
-                        this->past_state = MOTORS_AO_CENTER_M2_ST;
+                        this->past_state = MOTORS_AO_CENTER_ST;
                         TRIGGER_VOID_EVENT;
                     }
                     break;
@@ -449,51 +416,31 @@ static void Motors_dispatch(Motors * const this,
                 case MOTORS_AO_TIMEOUT_SIG:
                     break;
 
-                case MOTORS_AO_MOVE_SIG:{   // TODO: Motion profile precalculation
-                    int16_t deg_to_move = 0;                    
-                    printf("REceiving signal from Ui. I am motors");
-                    if(((MOTORS_AO_MOVE_PL*)e)->motor == M1){
-                        deg_to_move = -this->motor1_current_position + ((MOTORS_AO_MOVE_PL*)e)->degrees; 
-                        if(deg_to_move<0){
-                            this->movement_dir = MOTOR1_NEG_DIR;
-                            this->movement_steps = (uint16_t)((-deg_to_move
-                                                    *MOTOR1_TRANSMISSION_RATE
-                                                    *MOTOR1_STEPS_PER_REV)/3600);
-                        }else{
-                            this->movement_dir = MOTOR1_POS_DIR;
-                            this->movement_steps = (uint16_t) ((deg_to_move
-                                                    *MOTOR1_TRANSMISSION_RATE
-                                                    *MOTOR1_STEPS_PER_REV)/3600);
-                        }
-                        this->state = MOTORS_AO_MOVE_M1_ST;
-                        this->past_state = MOTORS_AO_WAITING_ST;
-
-                    }else{
-                        deg_to_move = -this->motor2_current_position + ((MOTORS_AO_MOVE_PL*)e)->degrees; 
-                        if(deg_to_move<0){
-                            this->movement_dir = MOTOR2_NEG_DIR;
-                            this->movement_steps = (uint16_t)((-deg_to_move
-                                                    *MOTOR2_TRANSMISSION_RATE
-                                                    *MOTOR2_STEPS_PER_REV)/3600);
-                        }else{
-                            this->movement_dir = MOTOR2_POS_DIR;
-                            this->movement_steps = (uint16_t) ((deg_to_move
-                                                    *MOTOR2_TRANSMISSION_RATE
-                                                    *MOTOR2_STEPS_PER_REV)/3600);
-                        }
-
-                        this->state = MOTORS_AO_MOVE_M2_ST;
-                        this->past_state = MOTORS_AO_WAITING_ST;
-                    }
-                    TRIGGER_VOID_EVENT;
-                    break;
-                }case MOTORS_AO_FREE_M1_SIG:{
-                    this->state = MOTORS_AO_FREE_M1_ST;
+                case MOTORS_AO_MOVE_SIG:{
+                    Motors_start_move(this, ((MOTORS_AO_MOVE_PL*)e)->motor,
+                                      ((MOTORS_AO_MOVE_PL*)e)->degrees,
+                                      ((MOTORS_AO_MOVE_PL*)e)->speed);
+                    this->state = MOTORS_AO_MOVE_ST;
                     this->past_state = MOTORS_AO_WAITING_ST;
                     TRIGGER_VOID_EVENT;
                     break;
-                }case MOTORS_AO_FREE_M2_SIG:{
-                    this->state = MOTORS_AO_FREE_M2_ST;
+                }case MOTORS_AO_RUN_PLAN_SIG:{
+                    Motors_plan_start(this, ((MOTORS_AO_PLAN_PL*)e)->plan, 
+                                      false, true);
+                    break;
+                }case MOTORS_AO_BATCH_SIG:{
+                    MOTORS_AO_BATCH_PL const* batch = (MOTORS_AO_BATCH_PL*)e;
+                    if(!Motion_plan_waypoints(&batch_plan, batch->waypoints, 
+                                              batch->count)){
+                        Active_post(AO_UI, (Event*)&batch_nack);
+                        break;
+                    }
+                    Motors_plan_start(this, &batch_plan, true, batch->progress);
+                    break;
+                }case MOTORS_AO_FREE_M1_SIG:
+                case MOTORS_AO_FREE_M2_SIG:{
+                    this->axis = signal_axis(e->sig);
+                    this->state = MOTORS_AO_FREE_ST;
                     this->past_state = MOTORS_AO_WAITING_ST;
                     TRIGGER_VOID_EVENT;
                     break;
@@ -502,135 +449,672 @@ static void Motors_dispatch(Motors * const this,
                     break;
             }
             break;
-        }case MOTORS_AO_MOVE_M1_ST:{
+        }case MOTORS_AO_MOVE_ST:{
             switch(e->sig){
                 case MOTORS_AO_TIMEOUT_SIG:{
-                    if(this->movement_steps<MOTOR1_MOVEMENT_STEPS){
-                        if(this->movement_steps != 0){
-                            StepperMotor_move(&(this->motor1), this->movement_dir,
-                                    MOTOR1_MOVEMENT_FREQ, this->movement_steps);
-                            uint16_t delta_deg = 0;
-                            if(this->movement_dir == MOTOR1_POS_DIR){
-                                delta_deg = (this->movement_steps*3600)/ (MOTOR1_TRANSMISSION_RATE
-                                                        *MOTOR1_STEPS_PER_REV);
-                                this->motor1_current_position = this->motor1_current_position + delta_deg;
-
-                            }else{
-                                delta_deg = (this->movement_steps*3600)/ (MOTOR1_TRANSMISSION_RATE
-                                                        *MOTOR1_STEPS_PER_REV);
-                                this->motor1_current_position = this->motor1_current_position - delta_deg;
-                            } 
-                        }
-                        this->movement_steps = 0;
-                        TimeEvent_arm(&this->te, (10 / portTICK_RATE_MS), 0U);
-
+                    if(Motors_move_tick(this)){
                         this->state = MOTORS_AO_WAITING_ST;
-                        this->past_state = MOTORS_AO_MOVE_M1_ST;
-                        static const Event move_m1_ack = {UI_AO_ACK_MOVE_SIG};
-                        Active_post(AO_UI, (Event*)&move_m1_ack);
-
-
-                    }else{
-                        TimeEvent_arm(&this->te, (10 / portTICK_RATE_MS), 0U);
-                        StepperMotor_move(&(this->motor1), this->movement_dir,
-                                    MOTOR1_MOVEMENT_FREQ, MOTOR1_MOVEMENT_STEPS);
-                        this->movement_steps -=MOTOR1_MOVEMENT_STEPS;
-                        uint16_t delta_deg = 0;
-                        if(this->movement_dir == MOTOR1_POS_DIR){
-                            delta_deg = (MOTOR1_MOVEMENT_STEPS*3600)/ (MOTOR1_TRANSMISSION_RATE
-                                                    *MOTOR1_STEPS_PER_REV);
-                            this->motor1_current_position = this->motor1_current_position + delta_deg;
-
-                        }else{
-                            delta_deg = (MOTOR1_MOVEMENT_STEPS*3600)/ (MOTOR1_TRANSMISSION_RATE
-                                                    *MOTOR1_STEPS_PER_REV);
-                            this->motor1_current_position = this->motor1_current_position - delta_deg;
-                        }                        
-                        
-                        
+                        this->past_state = MOTORS_AO_MOVE_ST;
+                        Motors_stall_report(this);
+                        static const Event move_ack = {UI_AO_ACK_MOVE_SIG};
+                        Active_post(AO_UI, (Event*)&move_ack);
                     }
                     break;
                     
+                }case MOTORS_AO_ENCODER_READ_SIG:{
+                    Motors_stall_check(this, (MOTORS_AO_ENCODER_PL*)e);
+                    break;
                 }default:
                     break;
             }
             break;
-        }case MOTORS_AO_MOVE_M2_ST:{
+        }case MOTORS_AO_PLAN_ST:{           // Routine execution
             switch(e->sig){
                 case MOTORS_AO_TIMEOUT_SIG:{
-                    if(this->movement_steps<MOTOR2_MOVEMENT_STEPS){
-                        if(this->movement_steps != 0){
-                            StepperMotor_move(&(this->motor2), this->movement_dir,
-                                    MOTOR2_MOVEMENT_FREQ, this->movement_steps);
-                            uint16_t delta_deg = 0;
-                            if(this->movement_dir == MOTOR2_POS_DIR){
-                                delta_deg = (this->movement_steps*3600)/ (MOTOR2_TRANSMISSION_RATE
-                                                        *MOTOR2_STEPS_PER_REV);
-                                this->motor2_current_position = this->motor2_current_position + delta_deg;
-
-                            }else{
-                                delta_deg = (this->movement_steps*3600)/ (MOTOR2_TRANSMISSION_RATE
-                                                        *MOTOR2_STEPS_PER_REV);
-                                this->motor2_current_position = this->motor2_current_position - delta_deg;
-                            } 
-                        }
-                        this->movement_steps = 0;
-                        TimeEvent_arm(&this->te, (10 / portTICK_RATE_MS), 0U);
-
-                        this->state = MOTORS_AO_WAITING_ST;
-                        this->past_state = MOTORS_AO_MOVE_M2_ST;
-                        static const Event move_m2_ack = {UI_AO_ACK_MOVE_SIG};
-                        Active_post(AO_UI, (Event*)&move_m2_ack);
-
-
-                    }else{
-                        TimeEvent_arm(&this->te, (10 / portTICK_RATE_MS), 0U);
-                        StepperMotor_move(&(this->motor2), this->movement_dir,
-                                    MOTOR2_MOVEMENT_FREQ, MOTOR2_MOVEMENT_STEPS);
-                        this->movement_steps-=MOTOR2_MOVEMENT_STEPS;
-                        uint16_t delta_deg = 0;
-                        if(this->movement_dir == MOTOR2_POS_DIR){
-                            delta_deg = (MOTOR2_MOVEMENT_STEPS*3600)/ (MOTOR2_TRANSMISSION_RATE
-                                                    *MOTOR2_STEPS_PER_REV);
-                            this->motor2_current_position = this->motor2_current_position + delta_deg;
-
-                        }else{
-                            delta_deg = (MOTOR2_MOVEMENT_STEPS*3600)/ (MOTOR2_TRANSMISSION_RATE
-                                                    *MOTOR2_STEPS_PER_REV);
-                            this->motor2_current_position = this->motor2_current_position - delta_deg;
-                        }    
+                    if(this->plan_paused){
+                        break;
+                    }
+                    // Moves are stepped by the timer, holds expire with it
+                    Motion_Plan_Op op = this->plan->steps[this->plan_step].op;
+                    if(op == MOTION_PLAN_MOVE && !Motors_move_tick(this)){
+                        break;
+                    }
+                    if((op == MOTION_PLAN_LINE || op == MOTION_PLAN_CIRCLE) &&
+                       !Motors_path_tick(this)){
+                        break;
                     }
+                    this->plan_step++;
+                    Motors_plan_run(this);
+                    break;
+                }case MOTORS_AO_PAUSE_PLAN_SIG:{
+                    TimeEvent_disarm(&this->te);
+                    this->plan_paused = true;
+                    break;
+                }case MOTORS_AO_RESUME_PLAN_SIG:{
+                    if(!this->plan_paused){
+                        break;
+                    }
+                    this->plan_paused = false;
+                    // Targets are absolute, restarting a step is always safe
+                    if(this->plan_in_rep){
+                        this->plan_step = this->plan_rep_start + 1;
+                    }
+                    Motors_plan_run(this);
+                    break;
+                }case MOTORS_AO_ENCODER_READ_SIG:{
+                    Motors_stall_check(this, (MOTORS_AO_ENCODER_PL*)e);
                     break;
-                    
                 }default:
                     break;
             }
             break;
 
-        
         }default:
             break;
     }
     }
+    Motors_publish(this);
 }
 
-static uint16_t read_encoder1(void){
-    
-    i2c_init(i2c1, 1000 * 1000);
-    AS5600_config_pins(ENCODER1_SDA_PIN,ENCODER1_SCL_PIN);
-    AS5600_config_pull_up(ENCODER1_SDA_PIN, ENCODER1_SCL_PIN);
-    uint16_t reading = AS5600_read_angle(i2c1);
-    AS5600_free_pins(ENCODER1_SDA_PIN,ENCODER1_SCL_PIN);
+/* Homing --------------------------------------------------------------------*/
+
+static void Motors_Homing_ctor(Motors_Homing * const homing,
+                               StepperMotor* motor,
+                               const Motors_Homing_Config* config){
+    homing->state = HOMING_START_ST;
+    homing->motor = motor;
+    homing->config = config;
+    homing->start_us = 0;
+    homing->time_ms = 0;
+    homing->zeroed = false;
+}
 
-    return reading;
+/**
+ * @brief Advance the homing of one axis, must be called periodically 
+ * (HOMING_POLL_MS) until it returns HOMING_DONE_ST or HOMING_ERROR_ST.
+ * The end switch is approached fast, the axis backs off and re-approaches
+ * slowly for precision, then the center is reached in one streamed move.
+ *
+ * @param homing Axis homing instance
+ * @return Current homing state
+ */
+static Motors_AO_Homing_state Motors_Homing_run(Motors_Homing * const homing){
+    const Motors_Homing_Config* config = homing->config;
+    bool home_reached = !gpio_get(config->end_switch);
+
+    switch(homing->state){
+        case HOMING_START_ST:{
+            homing->start_us = time_us_32();
+            if(home_reached){
+                StepperMotor_move(homing->motor, config->center_dir,
+                                  config->fast_freq, config->back_off_steps);
+                homing->state = HOMING_BACK_OFF_ST;
+            }else{
+                StepperMotor_move(homing->motor, config->approach_dir,
+                                  config->fast_freq, config->max_steps);
+                homing->state = HOMING_FAST_APPROACH_ST;
+            }
+            break;
+        }case HOMING_FAST_APPROACH_ST:{
+            if(home_reached){
+                StepperMotor_stop(homing->motor);
+                StepperMotor_move(homing->motor, config->center_dir,
+                                  config->fast_freq, config->back_off_steps);
+                homing->state = HOMING_BACK_OFF_ST;
+            }else if(!StepperMotor_is_moving(homing->motor)){
+                homing->state = HOMING_ERROR_ST;
+            }
+            break;
+        }case HOMING_BACK_OFF_ST:{
+            if(!StepperMotor_is_moving(homing->motor)){
+                StepperMotor_move(homing->motor, config->approach_dir,
+                                  config->slow_freq, 2*config->back_off_steps);
+                homing->state = HOMING_SLOW_APPROACH_ST;
+            }
+            break;
+        }case HOMING_SLOW_APPROACH_ST:{
+            if(home_reached){
+                StepperMotor_stop(homing->motor);
+                StepperMotor_move(homing->motor, config->center_dir,
+                                  config->center_freq,
+                                  config->home_to_center_steps);
+                homing->state = HOMING_CENTER_ST;
+            }else if(!StepperMotor_is_moving(homing->motor)){
+                homing->state = HOMING_ERROR_ST;
+            }
+            break;
+        }case HOMING_CENTER_ST:{
+            if(!StepperMotor_is_moving(homing->motor)){
+                homing->time_ms = (time_us_32() - homing->start_us) / 1000;
+                homing->state = HOMING_DONE_ST;
+            }
+            break;
+        }default:
+            break;
+    }
+    return homing->state;
 }
 
-static uint16_t read_encoder2(void){
-    
-    i2c_init(i2c1, 1000 * 1000);
-    AS5600_config_pins(ENCODER2_SDA_PIN,ENCODER2_SCL_PIN);
-    AS5600_config_pull_up(ENCODER2_SDA_PIN, ENCODER2_SCL_PIN);
-    uint16_t reading = AS5600_read_angle(i2c1);
-    AS5600_free_pins(ENCODER2_SDA_PIN,ENCODER2_SCL_PIN);
-    return reading;
-}
\ No newline at end of file
+/**
+ * @brief Disable every motor and report the problem to the UI
+ */
+static void motors_error(Motors * const this, Motors_Axis const* axis,
+                         char const* problem){
+    static UI_AO_ERROR_PL error_event = {UI_AO_ERROR_SIG};
+
+    TimeEvent_disarm(&this->te);
+    for(uint8_t i = 0; i < AXIS_COUNT; i++){
+        StepperMotor_stop(&(this->axes[i].motor));
+        StepperMotor_disable(&(this->axes[i].motor));
+    }
+    snprintf(error_event.error_message, sizeof(error_event.error_message),
+             "%s %s", axis->config->name, problem);
+    Active_post(AO_UI, (Event*)&error_event);
+    this->state = MOTORS_AO_WAITING_ST;
+}
+
+/**
+ * @brief Give up the stored calibration and home, right away if the UI has
+ * already asked for it
+ */
+static void fast_boot_reject(Motors * const this, char const* reason){
+    printf("Stored calibration rejected (%s), homing required\n", reason);
+    TimeEvent_disarm(&this->te);
+    this->state = MOTORS_AO_CALIB_ST;
+    this->past_state = MOTORS_AO_FAST_BOOT_ST;
+    if(this->calib_requested){
+        this->calib_start_us = time_us_32();
+        TRIGGER_VOID_EVENT;
+    }
+}
+
+/**
+ * @brief Check a reading against a stored zero, the encoder wraps at 4096
+ */
+static bool calib_matches(uint16_t reading, uint32_t zero){
+    int32_t distance = ((int32_t)reading - (int32_t)zero) % 4096;
+
+    if(distance > 2048){
+        distance -= 4096;
+    }else if(distance < -2048){
+        distance += 4096;
+    }
+    return distance <= FAST_BOOT_TOLERANCE && distance >= -FAST_BOOT_TOLERANCE;
+}
+
+/* Axis ----------------------------------------------------------------------*/
+
+static void Motors_Axis_ctor(Motors_Axis * const axis, AS5600_Bus* encoders,
+                             const Motors_Axis_Config* config){
+    axis->config = config;
+    axis->encoder_zero = 0;
+    axis->encoder_current_angle = 0;
+    axis->encoder_turns = 0;
+    axis->encoder_last_read = 0;
+    axis->encoder_read_us = 0;
+    axis->encoder_velocity = 0;
+    axis->current_position = 0;
+    axis->goal_position = 0;
+
+    StepperMotor_ctor(&(axis->motor), config->pio, config->sm, config->dir_pin, 
+                      config->step_pin, config->enable_pin, 
+                      STEPPER_STEPS_PER_TURN, config->transmission_rate);
+    axis->encoder_id = AS5600_Bus_add(encoders, config->encoder_sda,
+                                      config->encoder_scl);
+    Motors_Homing_ctor(&(axis->homing), &(axis->motor), &(config->homing));
+
+    // End switch
+    gpio_init(config->homing.end_switch);
+    gpio_pull_down(config->homing.end_switch);
+    gpio_set_dir(config->homing.end_switch, GPIO_IN);
+}
+
+/**
+ * @brief Track encoder turns and update the output angle from a raw reading
+ */
+static void Motors_Axis_update_angle(Motors_Axis * const axis, uint16_t read){
+    read += axis->config->encoder_offset;
+
+    // Identify overflow
+    if(read < 500 && axis->encoder_last_read > 3595){
+        axis->encoder_turns++;
+    }else if(read > 3595 && axis->encoder_last_read < 500){
+        axis->encoder_turns--;
+    }
+
+    int32_t counts = (int32_t)read - (int32_t)axis->encoder_zero
+                     + axis->encoder_turns*FP_COUNTS_PER_REV;
+    int32_t angle = motion_counts_to_deg10(axis->config->id,
+                                    axis->config->encoder_pos_dir ? -counts : counts);
+    uint32_t now = time_us_32();
+
+    if(axis->encoder_read_us != 0 && now != axis->encoder_read_us){
+        axis->encoder_velocity = (int32_t)((int64_t)(angle - axis->encoder_current_angle)
+                                           *1000000 / (int32_t)(now - axis->encoder_read_us));
+    }
+    axis->encoder_current_angle = angle;
+    axis->encoder_read_us = now;
+    axis->encoder_last_read = read;
+}
+
+/**
+ * @brief Publish the state of every axis to motors_snapshot
+ */
+static void Motors_publish(Motors * const this){
+    static Motors_Snapshot_Data data;
+
+    for(int i = 0; i < AXIS_COUNT; i++){
+        Motors_Axis const* axis = &(this->axes[i]);
+        data.axes[i].commanded = motion_steps_to_deg10(i, axis->current_position);
+        data.axes[i].measured = axis->encoder_current_angle;
+        data.axes[i].velocity = axis->encoder_velocity;
+        data.axes[i].read_us = axis->encoder_read_us;
+    }
+    data.state = this->state;
+    data.axis = this->axis;
+    data.updates++;
+    Motors_snapshot_write(&motors_snapshot, &data);
+}
+
+/**
+ * @brief Prepare the selected axis to go back to the encoder zero
+ */
+static void Motors_Axis_start_centering(Motors * const this){
+    Motors_Axis* axis = &(this->axes[this->axis]);
+
+    this->center_state = CENTER_PENDING_ST;
+    if(axis->encoder_current_angle<0){
+        this->centering_dir = axis->config->pos_dir;
+        this->centering_steps = (uint16_t)motion_deg10_to_steps(this->axis,
+                                            -axis->encoder_current_angle);
+    }else{
+        this->centering_dir = axis->config->neg_dir;
+        this->centering_steps = (uint16_t)motion_deg10_to_steps(this->axis,
+                                            axis->encoder_current_angle);
+    }
+}
+
+static Motors_Axis* encoder_axis(Motors * const this, uint8_t encoder){
+    for(uint8_t i = 0; i < AXIS_COUNT; i++){
+        if(this->axes[i].encoder_id == encoder){
+            return &(this->axes[i]);
+        }
+    }
+    return NULL;
+}
+
+// UI signals name the axis
+static Axis_Id signal_axis(Signal sig){
+    switch(sig){
+        case MOTORS_AO_FREE_M2_SIG:
+        case MOTORS_AO_BLOCK_M2_SIG:
+            return AXIS_M2;
+        default:
+            return AXIS_M1;
+    }
+}
+
+/**
+ * @brief Start an encoder read, the result arrives later as a 
+ * MOTORS_AO_ENCODER_READ_SIG event so the dispatch never waits on the bus.
+ *
+ * @return false if the bus is still busy with a previous read
+ */
+static bool read_encoder(Motors * const this, Axis_Id axis){
+    return AS5600_Bus_read_angle_async(&(this->encoders), 
+                                       this->axes[axis].encoder_id);
+}
+
+/* Motion --------------------------------------------------------------------*/
+
+/**
+ * @brief Prepare a smooth move of an axis to an absolute position, executed
+ * by Motors_move_tick()
+ *
+ * @param speed Peak joint speed (deg/s), 0 for the axis maximum
+ */
+static void Motors_start_move(Motors * const this, Axis_Id axis, 
+                              int32_t deg10, uint16_t speed){
+    Motors_Axis* moved = &(this->axes[axis]);
+    int32_t steps_to_move = motion_deg10_to_steps(axis, deg10)
+                            - moved->current_position;
+
+    this->axis = axis;
+    if(steps_to_move<0){
+        this->movement_dir = moved->config->neg_dir;
+        this->movement_steps = (uint16_t)(-steps_to_move);
+    }else{
+        this->movement_dir = moved->config->pos_dir;
+        this->movement_steps = (uint16_t)steps_to_move;
+    }
+    Motion_profile_init(&this->profile, MOTION_SHAPE, this->movement_steps,
+                        speed_freq(moved, speed));
+    this->check_countdown = 0;
+    this->check_pending = false;
+}
+
+// Peak step rate of a joint speed, never above the axis movement frequency
+static uint32_t speed_freq(Motors_Axis const* axis, uint16_t speed){
+    int32_t freq = motion_deg10_to_steps(axis->config->id, (int32_t)speed*10);
+
+    if(speed == 0 || freq >= (int32_t)axis->config->movement_freq){
+        return axis->config->movement_freq;
+    }
+    return freq > 0 ? (uint32_t)freq : 1;
+}
+
+/**
+ * @brief Send the steps of the next control period of the current move and
+ * arm the timer for the following one
+ *
+ * @return true once the move is complete
+ */
+static bool Motors_move_tick(Motors * const this){
+    Motors_Axis* axis = &(this->axes[this->axis]);
+    uint16_t steps = 0;
+    if(!Motors_stall_sample(this, this->axis)){
+        return false;               // Stopped by motors_error()
+    }
+    bool done = Motion_profile_next(&this->profile, &steps);
+
+    if(steps != 0){
+        StepperMotor_move(&(axis->motor), this->movement_dir,
+                          Motion_profile_freq(steps), steps);
+        axis->current_position += 
+                this->movement_dir == axis->config->pos_dir ? steps : -steps;
+    }
+    TimeEvent_arm(&this->te, (MOTION_CONTROL_PERIOD_MS / portTICK_RATE_MS), 0U);
+
+    return done;
+}
+
+/**
+ * @brief Prepare a coordinated M1 and M2 path from the current positions,
+ * executed by Motors_path_tick()
+ */
+static void Motors_start_path(Motors * const this, 
+                              Motion_Plan_Step const* step){
+    int32_t start[AXIS_COUNT];
+    int32_t end[AXIS_COUNT];
+    uint32_t max_freq[AXIS_COUNT];
+
+    for(int axis = 0; axis < AXIS_COUNT; axis++){
+        start[axis] = this->axes[axis].current_position;
+        max_freq[axis] = speed_freq(&(this->axes[axis]), step->speed);
+    }
+    if(step->op == MOTION_PLAN_LINE){
+        end[AXIS_M1] = motion_deg10_to_steps(AXIS_M1, step->value);
+        end[AXIS_M2] = motion_deg10_to_steps(AXIS_M2, step->aux);
+        Motion_path_line(&this->path, MOTION_SHAPE, start, end, max_freq);
+    }else{
+        int32_t radius[AXIS_COUNT];
+        for(int axis = 0; axis < AXIS_COUNT; axis++){
+            end[axis] = motion_deg10_to_steps(axis, step->aux);
+            radius[axis] = motion_deg10_to_steps(axis, step->value);
+        }
+        Motion_path_circle(&this->path, MOTION_SHAPE, end, radius, max_freq);
+    }
+    this->check_countdown = 0;
+    this->check_pending = false;
+}
+
+/**
+ * @brief Send every axis its steps of the next control period, so all of 
+ * them follow the path on the same time base
+ *
+ * @return true once the path is complete
+ */
+static bool Motors_path_tick(Motors * const this){
+    int32_t position[AXIS_COUNT];
+    // Axes take turns, the bus does one read at a time
+    if(!Motors_stall_sample(this, (this->check_axis + 1) % AXIS_COUNT)){
+        return false;               // Stopped by motors_error()
+    }
+    bool done = Motion_path_next(&this->path, position);
+
+    for(int i = 0; i < AXIS_COUNT; i++){
+        Motors_Axis* axis = &(this->axes[i]);
+        int32_t delta = position[i] - axis->current_position;
+
+        if(delta != 0){
+            uint16_t steps = (uint16_t)(delta < 0 ? -delta : delta);
+            StepperMotor_move(&(axis->motor), 
+                              delta < 0 ? axis->config->neg_dir : axis->config->pos_dir,
+                              Motion_profile_freq(steps), steps);
+            axis->current_position = position[i];
+        }
+    }
+    TimeEvent_arm(&this->te, (MOTION_CONTROL_PERIOD_MS / portTICK_RATE_MS), 0U);
+
+    return done;
+}
+
+static void Motors_plan_start(Motors * const this, Motion_Plan const* plan,
+                              bool batch, bool progress){
+    this->plan = plan;
+    this->plan_step = 0;
+    this->plan_in_rep = false;
+    this->plan_paused = false;
+    this->plan_batch = batch;
+    this->plan_progress = progress;
+    this->state = MOTORS_AO_PLAN_ST;
+    this->past_state = MOTORS_AO_WAITING_ST;
+    Motors_plan_run(this);
+}
+
+/**
+ * @brief Execute plan steps from plan_step until one that takes time, or 
+ * report the end of the plan
+ */
+static void Motors_plan_run(Motors * const this){
+    while(this->plan_step < this->plan->num_steps){
+        Motion_Plan_Step const* step = &(this->plan->steps[this->plan_step]);
+
+        switch(step->op){
+            case MOTION_PLAN_REP_START:{
+                this->plan_rep_start = this->plan_step;
+                this->plan_rep_start_us = time_us_32();
+                this->plan_rep = 0;
+                this->plan_in_rep = true;
+                this->plan_step++;
+                break;
+            }case MOTION_PLAN_REPEAT:{
+                if(++this->plan_rep < step->value){
+                    this->plan_step = this->plan_rep_start + 1;
+                }else{
+                    // Includes holds and any pause, as seen by the patient
+                    uint32_t elapsed_ms = (time_us_32() - this->plan_rep_start_us)/1000;
+                    uint32_t rate = elapsed_ms ? this->plan_rep*60000U*100U/elapsed_ms : 0;
+                    printf("Exercise %d: %d reps in %lu ms, %lu.%02lu reps/min\n",
+                           step->exercise + 1, this->plan_rep, elapsed_ms, 
+                           rate/100, rate%100);
+                    this->plan_in_rep = false;
+                    this->plan_step++;
+                }
+                break;
+            }case MOTION_PLAN_MOVE:{
+                plan_progress(this, step);
+                Motors_start_move(this, step->axis, step->value, step->speed);
+                TRIGGER_VOID_EVENT;
+                return;
+            }case MOTION_PLAN_LINE:
+            case MOTION_PLAN_CIRCLE:{
+                plan_progress(this, step);
+                Motors_start_path(this, step);
+                TRIGGER_VOID_EVENT;
+                return;
+            }case MOTION_PLAN_HOLD:{
+                plan_progress(this, step);
+                TimeEvent_arm(&this->te, 
+                              ((step->value > 0 ? step->value : 1) / portTICK_RATE_MS), 
+                              0U);
+                return;
+            }default:
+                this->plan_step++;
+                break;
+        }
+    }
+
+    if(this->plan_batch){
+        static const Event batch_ack = {UI_AO_ACK_MOVE_SIG};
+        Active_post(AO_UI, (Event*)&batch_ack);
+    }else{
+        static const Motion_Plan_Step finished = {.phase = MOTION_PLAN_FINISHED};
+        plan_progress(this, &finished);
+    }
+    Motors_stall_report(this);
+    this->state = MOTORS_AO_WAITING_ST;
+    this->past_state = MOTORS_AO_PLAN_ST;
+}
+
+/* Stall detection -----------------------------------------------------------*/
+
+/**
+ * @brief Start a check read of an axis every STALL_CHECK_PERIODS ticks. Called
+ * before the tick issues its steps, so the previous chunk is already done.
+ *
+ * @return false if lost reads stopped the motors
+ */
+static bool Motors_stall_sample(Motors * const this, Axis_Id axis){
+    if(this->check_pending){
+        this->check_pending = false;
+        if(Motors_stall_miss(this)){
+            return false;
+        }
+    }
+    if(this->check_countdown > 0){
+        this->check_countdown--;
+        return true;
+    }
+    if(read_encoder(this, axis)){
+        this->check_axis = axis;
+        this->check_expected = this->axes[axis].current_position;
+        this->check_pending = true;
+        this->check_countdown = STALL_CHECK_PERIODS - 1;
+    }
+    return true;
+}
+
+/**
+ * @brief Count a check read that failed or never answered
+ *
+ * @return true if STALL_MAX_MISSES in a row stopped the motors
+ */
+static bool Motors_stall_miss(Motors * const this){
+    Motors_Axis const* axis = &(this->axes[this->check_axis]);
+
+    this->check_missed++;
+    if(++this->check_misses < STALL_MAX_MISSES){
+        return false;
+    }
+    printf("%s encoder lost: %u check reads missed\n", axis->config->name,
+           this->check_misses);
+    motors_error(this, axis, "encoder lost");
+    return true;
+}
+
+/**
+ * @brief Compare a check read with the expected position, re-sync small 
+ * drift and stop on a stall
+ *
+ * @return true if the axis stalled or lost reads stopped the motors
+ */
+static bool Motors_stall_check(Motors * const this, 
+                               MOTORS_AO_ENCODER_PL const* read){
+    Motors_Axis* axis = encoder_axis(this, read->encoder);
+    if(!this->check_pending || axis == NULL || axis->config->id != this->check_axis){
+        return false;
+    }
+    uint32_t start_us = time_us_32();
+    this->check_pending = false;
+    if(!read->ok){
+        return Motors_stall_miss(this);
+    }
+    this->check_misses = 0;
+
+    // Motor shaft counts, both sides taken modulo one turn
+    int32_t counts = (int32_t)(uint16_t)(read->angle + axis->config->encoder_offset)
+                     - (int32_t)axis->encoder_zero;
+    if(axis->config->encoder_pos_dir){
+        counts = -counts;
+    }
+    int32_t steps_per_rev = axis->config->steps_per_rev;
+    int32_t expected = (int32_t)((int64_t)this->check_expected*FP_COUNTS_PER_REV
+                                 / steps_per_rev);
+    int32_t error = (counts - expected) & (FP_COUNTS_PER_REV - 1);
+    if(error >= FP_COUNTS_PER_REV/2){
+        error -= FP_COUNTS_PER_REV;
+    }
+    int32_t error_steps = fp_div_round(error*steps_per_rev, FP_COUNTS_PER_REV);
+    bool stalled = abs(error_steps) > STALL_TOLERANCE_STEPS;
+
+    if(!stalled && abs(error_steps) > STALL_DEADBAND_STEPS){
+        // Paths target absolute positions and absorb it, single moves end
+        // off by the error but the next one starts from the right place
+        axis->current_position += error_steps;
+        this->check_resyncs++;
+    }
+
+    uint32_t elapsed_us = time_us_32() - start_us;
+    this->check_count++;
+    this->check_us_total += elapsed_us;
+    if(elapsed_us > this->check_us_max){
+        this->check_us_max = elapsed_us;
+    }
+
+    if(stalled){
+        printf("%s stalled: %ld steps behind\n", axis->config->name, 
+               -error_steps);
+        motors_error(this, axis, "stalled");
+    }
+    return stalled;
+}
+
+static void Motors_stall_report(Motors * const this){
+    if(this->check_count == 0 && this->check_missed == 0){
+        return;
+    }
+    printf("Stall check: %lu checks, %lu us avg, %lu us max, %u re-syncs, "
+           "%u missed\n",
+           this->check_count, 
+           this->check_count ? this->check_us_total / this->check_count : 0,
+           this->check_us_max, this->check_resyncs, this->check_missed);
+    this->check_count = 0;
+    this->check_us_total = 0;
+    this->check_us_max = 0;
+    this->check_resyncs = 0;
+    this->check_missed = 0;
+}
+
+static void plan_progress(Motors * const this, Motion_Plan_Step const* step){
+    if(!this->plan_progress){
+        return;
+    }
+    // Consecutive steps may start before the UI handles the previous event
+    static UI_AO_PLAN_PROGRESS_PL progress_events[4];
+    static uint8_t next_event = 0;
+    UI_AO_PLAN_PROGRESS_PL* progress = &progress_events[next_event];
+
+    next_event = (next_event + 1) % 4;
+    progress->super.sig = UI_AO_PLAN_PROGRESS_SIG;
+    progress->phase = step->phase;
+    progress->exercise = step->exercise;
+    progress->rep = this->plan_rep;
+    progress->value = step->value;
+    Active_post(AO_UI, (Event*)progress);
+}
+
+// DMA or I2C interrupt context
+static void encoder_read_done(void* context, uint8_t encoder, uint16_t angle,
+                              bool ok){
+    static MOTORS_AO_ENCODER_PL encoder_read_event[AS5600_BUS_MAX_ENCODERS];
+    BaseType_t xHigherPriorityTaskWoken = pdFALSE;
+
+    encoder_read_event[encoder].super.sig = MOTORS_AO_ENCODER_READ_SIG;
+    encoder_read_event[encoder].encoder = encoder;
+    encoder_read_event[encoder].angle = angle;
+    encoder_read_event[encoder].ok = ok;
+    Active_postFromISR((Active*)context, &encoder_read_event[encoder].super,
+                       &xHigherPriorityTaskWoken);
+    portYIELD_FROM_ISR(xHigherPriorityTaskWoken);
+}
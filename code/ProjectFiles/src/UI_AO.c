@@ -20,6 +20,7 @@
 
 // SDK Libraries
 #include "pico/stdlib.h"
+#include "hardware/clocks.h"
 //#include "hardware/uart.h"
 //#include "hardware/gpio.h"
 
@@ -34,9 +35,12 @@
 
 #include "printer_AO.h"
 #include "Motors_AO.h" 
+#include "motion_plan.h"
 
 // Project libraries
 #include "bsp.h"
+#include "text_format.h"
+#include "lcd_bar.h"
 
 #define TRIGGER_VOID_EVENT TimeEvent_arm(&this->te, (1 / portTICK_RATE_MS), 0U)
 
@@ -44,18 +48,40 @@
 
 
 
-// Global UI_States variables
-static UI_State HOME = {" ***  Welcome!  *** "};
-static UI_State CALIBRATE = {"    Calibrating...  "};
-static UI_State INICIO = {" Choose an option:  ", 2,{" Create Routine     ", " Do default routine "}};
-static UI_State CREATE = {" Add exercise       ", 4, {" PronoSupination    ", " FlexoExtension     ", " Ab-,Adduction      ", " Begin Routine      "}};
-static UI_State DO_DEFAULT = {" Default routine:   ", 2, {" Check Routine first", " Do routine now     "}};
-static UI_State CONFIG_EXERCISE = {"Config. ", 5, {" Repetitions: 1     ", " Min. Angle: -20    ", " Max. Angle: 20     ", " Time: 3            ", " Exercise Ready     "}};
-static UI_State BEGIN_ROUTINE = {" Created routine    ", 3,{" Check Routine first", " Do routine now     ", " Set pause betw. ex."}};
-static UI_State CHECK_ROUTINE = {"Check routine:      ", 2, {" See exercises      ", " See pause betw. ex."}};
-static UI_State SHOW_EXERCISES = {"See exercises:      ", 10, {" Exercise 1         ", " Exercise 2         ", " Exercise 3         ", " Exercise 4         ",
-                                    " Exercise 5         ", " Exercise 6         ", " Exercise 7         ", " Exercise 8         ", " Exercise 9         ", " Exercise 10        "}};
-static UI_State SHOW_AN_EXERCISE = {" Exercise           ", 5, {" Type:              ", " Repetitions:       ", " Min. Angle:        ", " Max. Angle:        ", " Time:              "}};
+// Rows edited at run time, 20 characters and a terminator
+static char config_title[21] = "Config. ";
+static char config_rows[5][21] = {" Repetitions: 1     ", " Min. Angle: -20    ", " Max. Angle: 20     ", 
+                                  " Time: 3            ", " Speed (deg/s): 30  "};
+static char exercise_title[21] = " Exercise           ";
+static char exercise_rows[6][21] = {" Type:              ", " Repetitions:       ", " Min. Angle:        ", " Max. Angle:        ", 
+                                    " Time:              ", " Speed (deg/s):     "};
+
+// Menu options
+static char const* const INICIO_OPTIONS[] = {" Create Routine     ", " Do default routine "};
+static char const* const CREATE_OPTIONS[] = {" PronoSupination    ", " FlexoExtension     ", " Ab-,Adduction      ", " Circumduction      ",
+                                             " Diagonal           ", " Begin Routine      "};
+static char const* const DO_DEFAULT_OPTIONS[] = {" Check Routine first", " Do routine now     "};
+static char const* const CONFIG_EXERCISE_OPTIONS[] = {config_rows[0], config_rows[1], config_rows[2], config_rows[3], 
+                                                      config_rows[4], " Exercise Ready     "};
+static char const* const BEGIN_ROUTINE_OPTIONS[] = {" Check Routine first", " Do routine now     ", " Set pause betw. ex."};
+static char const* const CHECK_ROUTINE_OPTIONS[] = {" See exercises      ", " See pause betw. ex."};
+static char const* const SHOW_EXERCISES_OPTIONS[] = {" Exercise 1         ", " Exercise 2         ", " Exercise 3         ", " Exercise 4         ",
+                                                     " Exercise 5         ", " Exercise 6         ", " Exercise 7         ", " Exercise 8         ", 
+                                                     " Exercise 9         ", " Exercise 10        "};
+static char const* const SHOW_AN_EXERCISE_OPTIONS[] = {exercise_rows[0], exercise_rows[1], exercise_rows[2], exercise_rows[3], 
+                                                       exercise_rows[4], exercise_rows[5]};
+
+// Global menus
+static char const HOME_TITLE[] = " ***  Welcome!  *** ";
+static char const CALIBRATE_TITLE[] = "    Calibrating...  ";
+static const UI_Menu INICIO = UI_MENU(" Choose an option:  ", INICIO_OPTIONS);
+static const UI_Menu CREATE = UI_MENU(" Add exercise       ", CREATE_OPTIONS);
+static const UI_Menu DO_DEFAULT = UI_MENU(" Default routine:   ", DO_DEFAULT_OPTIONS);
+static const UI_Menu CONFIG_EXERCISE = UI_MENU(config_title, CONFIG_EXERCISE_OPTIONS);
+static const UI_Menu BEGIN_ROUTINE = UI_MENU(" Created routine    ", BEGIN_ROUTINE_OPTIONS);
+static const UI_Menu CHECK_ROUTINE = UI_MENU("Check routine:      ", CHECK_ROUTINE_OPTIONS);
+static UI_Menu SHOW_EXERCISES = UI_MENU("See exercises:      ", SHOW_EXERCISES_OPTIONS);   // Count set by the routine
+static const UI_Menu SHOW_AN_EXERCISE = UI_MENU(exercise_title, SHOW_AN_EXERCISE_OPTIONS);
 
 //Global iterator
 uint i = 0;
@@ -66,26 +92,27 @@ char modified_buffer[20];
 //select min or max angle
 uint angle = 0; //o: min, 1:max
 
-char availableExercises[3][12] = {"PronoSup.", "FlexoExt.", "Ab-,Adduc."};
+char availableExercises[5][12] = {"PronoSup.", "FlexoExt.", "Ab-,Adduc.", "Circumduc.", "Diagonal"};
 
 //previous parameter values
 int8_t prev_reps;
 int8_t prev_time;
+int8_t prev_speed;
 int8_t prev_pause;
 int16_t prev_max_angle;
 int16_t prev_min_angle;
 
 //new angle from encoder
 int16_t new_angle = 5;
+int16_t shown_angle;
+bool measuring = false;     // Axis freed, sampling its angle
 
 //counter
 int8_t counter = 3;
+int8_t counter_total;       // Countdown start, for its bar
 
 int8_t delta_angle = 20;
 
-//used to save numerical value in char value
-char char_data[3];
-
 //error messages
 char error_message1[20];
 char error_message2[20];
@@ -94,13 +121,13 @@ char error_message2[20];
 bool pause_active = false;
 
 //Exercises for default routine:
-Exercise default_exercise_1 = {0, 2, -450, 450, 3};
-Exercise default_exercise_2 = {1, 2, -600, 600, 3};
-Exercise default_exercise_3 = {2, 2, -300, 300, 3};
-Exercise default_exercise_4 = {1, 2, -400, 400, 3};
-Exercise default_exercise_5 = {0, 2, -600, 600, 3};
-Exercise default_exercise_6 = {2, 2, -450, 450, 3};
-Exercise default_exercise_7 = {0, 2, -600, 600, 3};
+Exercise default_exercise_1 = {0, 2, -450, 450, 3, 30};
+Exercise default_exercise_2 = {1, 2, -600, 600, 3, 30};
+Exercise default_exercise_3 = {2, 2, -300, 300, 3, 30};
+Exercise default_exercise_4 = {1, 2, -400, 400, 3, 30};
+Exercise default_exercise_5 = {0, 2, -600, 600, 3, 30};
+Exercise default_exercise_6 = {2, 2, -450, 450, 3, 30};
+Exercise default_exercise_7 = {0, 2, -600, 600, 3, 30};
 
 //Selected routine. 0: default routine, 1: created routine
 int8_t selected_routine = 0;
@@ -108,16 +135,17 @@ int8_t selected_routine = 0;
 //number of exercise to see or execute
 uint selected_exercise = 0;
 
-uint current_repetition = 0;
-bool inicio;
 bool inExercise = false;
+bool calibrated = false;    // Motors accepted the stored calibration
 
 //Routines
 Routine created_routine;
 Routine default_routine;
 Routine routine_to_do;
 
-int16_t degrees_to_send = 0; 
+//Routine compiled for the motors AO
+static Motion_Plan routine_plan;
+uint8_t plan_phase;
 
 
 /* AO Class Constructor ------------------------------------------------------*/
@@ -145,11 +173,13 @@ void UI_ctor(UI * const this){
     this->default_min_angle = -200;
     this->default_max_angle = 200;
     this->default_time_in_position = 3;
+    this->default_speed = 30;
     this->default_pause_between_exercises = 5;
 
     // // limit values for exercise parameters
     this->max_reps = 50;
     this->max_secs = 100;
+    this->max_speed = 90;
     this->max_pause = 100;
 
     //initialize exercise parameters
@@ -157,6 +187,7 @@ void UI_ctor(UI * const this){
     this->min_angle = this->default_min_angle;
     this->max_angle = this->default_max_angle;
     this->time_in_position = this->default_time_in_position;
+    this->speed = this->default_speed;
     this->pause_between_exercises = this->default_pause_between_exercises;
 
 
@@ -193,6 +224,9 @@ static void UI_dispatch(UI * const this, //dispatch se ejecuta siempre
                                   Event const * const e){
 
     if(e->sig == INIT_SIG){ 
+#if UI_FORMAT_BENCHMARK
+        UI_format_benchmark();
+#endif
         TRIGGER_VOID_EVENT;
         
     }else{
@@ -205,23 +239,35 @@ static void UI_dispatch(UI * const this, //dispatch se ejecuta siempre
         if(e->sig == UI_AO_SW5_PRESSED_SIG){
             if(inExercise){
                 if(!pause_active){
+                    static const Event pause_event = {MOTORS_AO_PAUSE_PLAN_SIG};
+                    Active_post(AO_Motors, (Event*)&pause_event);
+                    TimeEvent_disarm(&this->te);
                     this->state = UI_AO_PAUSE_ST;
                     pause_active = true;
                 }
                 else{
-                    this->state = UI_AO_END_OF_REPETITION_ST;
+                    // The current repetition is done again
+                    static const Event resume_event = {MOTORS_AO_RESUME_PLAN_SIG};
+                    Active_post(AO_Motors, (Event*)&resume_event);
+                    this->state = UI_AO_RUN_ROUTINE_ST;
                     display_row1("Resuming            ");
                     display_row2("from pause...       ");
                     pause_active = false;
-                    current_repetition--;
-                    TRIGGER_VOID_EVENT;
-                    
                 }
             }
         }
         switch(this->state){
 
             case UI_AO_PAUSE_ST:{
+                if(e->sig == UI_AO_PLAN_PROGRESS_SIG && 
+                   ((UI_AO_PLAN_PROGRESS_PL*)e)->phase == MOTION_PLAN_FINISHED){
+                    // Routine ended before the pause was handled
+                    pause_active = false;
+                    inExercise = false;
+                    this->state = UI_AO_INICIO_ST;
+                    TRIGGER_VOID_EVENT;
+                    break;
+                }
                 display_rows("System was          ", "paused              ", "                    ", "                    ");              
             break;
             }
@@ -233,11 +279,16 @@ static void UI_dispatch(UI * const this, //dispatch se ejecuta siempre
                 switch (e->sig){
                     
                     case UI_AO_TIMEOUT_SIG:{
-                        this->state = UI_AO_REMOVE_HANDS_ST;
-                        display_row2(HOME.title);
+                        // Warm boot, no homing needed
+                        this->state = calibrated ? UI_AO_INICIO_ST : 
+                                                   UI_AO_REMOVE_HANDS_ST;
+                        display_row2(HOME_TITLE);
                         TimeEvent_arm(&this->te, (2500 / portTICK_RATE_MS), 0U);
                         inExercise = false;
                     break;
+                    }case UI_AO_ACK_CALIB_SIG:{
+                        calibrated = true;
+                    break;
                     }default:
                         break;                
                 }
@@ -255,14 +306,20 @@ static void UI_dispatch(UI * const this, //dispatch se ejecuta siempre
                             TimeEvent_arm(&this->te, (1500 / portTICK_RATE_MS), 0U);
                         }
                         else{
-                        sprintf(char_data,"%ld", counter);
-                        change_string(modified_buffer, 0, char_data);
+                        Text_put_int(modified_buffer, 0, counter);
                         display_rows("   Take hands off   ", "     the device     ", "   Calibrating in   ", modified_buffer);
                         counter--;
                         TimeEvent_arm(&this->te, (1000 / portTICK_RATE_MS), 0U);
                         }                        
                         break;
                     }
+                    case UI_AO_ACK_CALIB_SIG:{
+                        calibrated = true;
+                        counter = 3;
+                        this->state = UI_AO_INICIO_ST;
+                        TRIGGER_VOID_EVENT;
+                        break;
+                    }
                     default:
                         break;
                 }
@@ -273,7 +330,7 @@ static void UI_dispatch(UI * const this, //dispatch se ejecuta siempre
                 switch (e->sig){
 
                     case UI_AO_TIMEOUT_SIG:{
-                        display_rows("                    ", CALIBRATE.title, "                    ", "                    ");                       
+                        display_rows("                    ", CALIBRATE_TITLE, "                    ", "                    ");                       
                         static Event calib_event = {MOTORS_AO_START_CALIB_SIG};
                         Active_post(AO_Motors, (Event*)&calib_event);                        
                         break;
@@ -294,17 +351,17 @@ static void UI_dispatch(UI * const this, //dispatch se ejecuta siempre
                 switch (e->sig){ 
                             
                     case UI_AO_TIMEOUT_SIG:{
-                        display_inicio(INICIO);
+                        display_inicio(&INICIO);
                     break;
                     }
 
                     case UI_AO_SW3_PRESSED_SIG:{
-                        display_plus_button(INICIO); 
+                        display_plus_button(&INICIO); 
                     break;
                     }
 
                     case UI_AO_SW2_PRESSED_SIG:{
-                        display_minus_button(INICIO); 
+                        display_minus_button(&INICIO); 
                     break;
                     }
 
@@ -324,21 +381,21 @@ static void UI_dispatch(UI * const this, //dispatch se ejecuta siempre
                 switch (e->sig){
                     
                     case UI_AO_TIMEOUT_SIG:{
-                        display_inicio(CREATE);
+                        display_inicio(&CREATE);
                     break;
                     }
 
                     case UI_AO_SW3_PRESSED_SIG:{
-                        display_plus_button(CREATE);                                           
+                        display_plus_button(&CREATE);                                           
                     break;
                     }
                     case UI_AO_SW2_PRESSED_SIG:{
-                        display_minus_button(CREATE);
+                        display_minus_button(&CREATE);
                                            
                     break;
                     }
                     case UI_AO_SW4_PRESSED_SIG:{
-                        this->state = (i == 3) ? UI_AO_BEGIN_ROUTINE_ST : UI_AO_CONFIG_EXERCISE_ST;               
+                        this->state = (i == 5) ? UI_AO_BEGIN_ROUTINE_ST : UI_AO_CONFIG_EXERCISE_ST;               
                         this->exercise_type = i;
                         i = 0;
                         TRIGGER_VOID_EVENT;                                           
@@ -360,17 +417,17 @@ static void UI_dispatch(UI * const this, //dispatch se ejecuta siempre
                 switch (e->sig){
                 
                     case UI_AO_TIMEOUT_SIG:{                    
-                        change_string(CONFIG_EXERCISE.title, 8, availableExercises[this->exercise_type]);
-                        display_inicio(CONFIG_EXERCISE);    
+                        change_string(config_title, 8, availableExercises[this->exercise_type]);
+                        display_inicio(&CONFIG_EXERCISE);    
                                                         
                     break;
                     }
                     case UI_AO_SW3_PRESSED_SIG:{
-                        display_plus_button(CONFIG_EXERCISE);                                           
+                        display_plus_button(&CONFIG_EXERCISE);                                           
                     break;
                     }
                     case UI_AO_SW2_PRESSED_SIG:{
-                        display_minus_button(CONFIG_EXERCISE);                                           
+                        display_minus_button(&CONFIG_EXERCISE);                                           
                     break;
                     }
                     case UI_AO_SW4_PRESSED_SIG:{
@@ -394,6 +451,10 @@ static void UI_dispatch(UI * const this, //dispatch se ejecuta siempre
                             break;
                             }
                             case 4:{
+                                this->state = UI_AO_SPEED_ST;
+                            break;
+                            }
+                            case 5:{
                                 this->state = UI_AO_EXERCISE_READY_ST;
                             break;
                             }
@@ -421,16 +482,14 @@ static void UI_dispatch(UI * const this, //dispatch se ejecuta siempre
                     
                     case UI_AO_TIMEOUT_SIG:{                        
                         prev_reps = this->reps;
-                        sprintf(char_data,"%ld", this->reps);
-                        change_string(modified_buffer, 0, char_data);
+                        Text_put_int(modified_buffer, 0, this->reps);
                         display_rows("   Set number of    ", "    repetitions:    ", "--------------------", modified_buffer);                       
                     break;
                     }
                     case UI_AO_SW3_PRESSED_SIG:{
                         if(this->reps <this->max_reps){
                             this->reps++;
-                            sprintf(char_data,"%ld", this->reps);
-                            change_string(modified_buffer, 0, char_data);
+                            Text_put_int(modified_buffer, 0, this->reps);
                             display_row4(modified_buffer);                            
                         }                       
                                            
@@ -439,16 +498,14 @@ static void UI_dispatch(UI * const this, //dispatch se ejecuta siempre
                     case UI_AO_SW2_PRESSED_SIG:{
                         if(this->reps > 1){
                             this->reps--;
-                            sprintf(char_data,"%ld", this->reps);
-                            change_string(modified_buffer, 0, char_data);
+                            Text_put_int(modified_buffer, 0, this->reps);
                             display_row4(modified_buffer);
                         }                       
                                            
                     break;
                     }
                     case UI_AO_SW4_PRESSED_SIG:{
-                        sprintf(char_data,"%ld", this->reps);
-                        change_string(CONFIG_EXERCISE.options[0], 14, char_data);
+                        Text_put_int(config_rows[0], 14, this->reps);
                         i = 0;
                         this->state = UI_AO_CONFIG_EXERCISE_ST; 
                         TRIGGER_VOID_EVENT;                                           
@@ -471,20 +528,40 @@ static void UI_dispatch(UI * const this, //dispatch se ejecuta siempre
                 switch (e->sig){
                     
                     case UI_AO_TIMEOUT_SIG:{
-                        if(this->exercise_type == 0 || this-> exercise_type == 1){
-                            printf("Sending signal to motors ex. 0 y 1");
-                            static MOTORS_AO_MOVE_PL vertical_movement_event = {MOTORS_AO_MOVE_SIG, M2, 0};
-                            Active_post(AO_Motors, (Event*)&vertical_movement_event);
-                            display_rows("    Positioning     ", "        bar         ", "     vertically     ", "                    ");
-                        }                        
+                        // One waypoint batch, the bar settles before the
+                        // angles are set as it does in a routine
+                        static Motion_Waypoint bar_waypoint = {AXIS_M2, 0, 0, MOTION_PLAN_BAR_SETTLE_MS};
+                        static MOTORS_AO_BATCH_PL bar_batch = {{MOTORS_AO_BATCH_SIG}, &bar_waypoint, 1, true};
+                        if(this->exercise_type != 2){
+                            printf("Sending signal to motors ex. 0, 1, 3 y 4");
+                            bar_waypoint.target = MOTION_PLAN_BAR_VERTICAL;
+                        }
                         else if(this->exercise_type == 2){
                             printf("Sending signal to motors ex. 2");
-                            static MOTORS_AO_MOVE_PL horizontal_movement_event = {MOTORS_AO_MOVE_SIG, M2, -900};
-                            Active_post(AO_Motors, (Event*)&horizontal_movement_event);
-                            display_rows("    Positioning     ", "         bar        ", "    horizontally    ", "                    ");
+                            bar_waypoint.target = MOTION_PLAN_BAR_HORIZONTAL;
                         }
+                        Active_post(AO_Motors, (Event*)&bar_batch);
+                    break;
+                    }
+                    case UI_AO_PLAN_PROGRESS_SIG:{
+                        UI_AO_PLAN_PROGRESS_PL const* progress = (UI_AO_PLAN_PROGRESS_PL*)e;
+                        if(progress->phase == MOTION_PLAN_WAYPOINT){
+                            if(progress->value == MOTION_PLAN_BAR_HORIZONTAL){
+                                display_rows("    Positioning     ", "         bar        ", "    horizontally    ", "                    ");
+                            }else{
+                                display_rows("    Positioning     ", "        bar         ", "     vertically     ", "                    ");
+                            }
+                        }else if(progress->phase == MOTION_PLAN_DWELL){
+                            display_row4("   Bar settling     ");
+                        }
+                    break;
+                    }
+                    case UI_AO_NACK_MOVE_SIG:{
+                        display_rows("   Bar not moved    ", "                    ", "  Motors are busy   ", "                    ");
+                        this->state = UI_AO_CONFIG_EXERCISE_ST;
+                        TimeEvent_arm(&this->te, (2000/ portTICK_RATE_MS), 0U);
                     break;
-                    }                      
+                    }
                     case UI_AO_ACK_MOVE_SIG:{
                         printf("ACK move from motors received\n");
                         if(angle == 0){
@@ -505,16 +582,14 @@ static void UI_dispatch(UI * const this, //dispatch se ejecuta siempre
                 switch(e->sig){
                     case UI_AO_TIMEOUT_SIG:{                        
                         prev_max_angle = this->max_angle;
-                        sprintf(char_data,"%ld", this->max_angle/10);
-                        change_string(modified_buffer, 0, char_data);
-                        display_rows("  Set max. angle:   ", "--------------------", "                    ", modified_buffer);                       
+                        put_angle(modified_buffer, this->max_angle, false);
+                        display_rows("  Set max. angle:   ", "--------------------", "Pause key: by hand  ", modified_buffer);                       
                     break;
                     }
                     case UI_AO_SW3_PRESSED_SIG:{
                         if(this->max_angle < 900){
                             this->max_angle+= delta_angle;
-                            sprintf(char_data,"%ld", this->max_angle/10);
-                            change_string(modified_buffer, 0, char_data);
+                            put_angle(modified_buffer, this->max_angle, false);
                             display_row4(modified_buffer);                            
                         }                       
                                            
@@ -523,21 +598,25 @@ static void UI_dispatch(UI * const this, //dispatch se ejecuta siempre
                     case UI_AO_SW2_PRESSED_SIG:{
                         if(this->max_angle > -900){
                             this->max_angle-= delta_angle;
-                            sprintf(char_data,"%ld", this->max_angle/10);
-                            change_string(modified_buffer, 0, char_data);
+                            put_angle(modified_buffer, this->max_angle, false);
                             display_row4(modified_buffer);
                         }                       
                                            
                     break;
                     }
                     case UI_AO_SW4_PRESSED_SIG:{
-                        sprintf(char_data,"%ld", this->max_angle/10);
-                        change_string(CONFIG_EXERCISE.options[2], 13, char_data);
+                        Text_put_int(config_rows[2], 13, this->max_angle/10);
                         i = 0;
                         this->state = UI_AO_CONFIG_EXERCISE_ST; 
                         TRIGGER_VOID_EVENT;                                           
                     break;
                     }               
+                    case UI_AO_SW5_PRESSED_SIG:{
+                        // Free the axis and read the angle it is moved to
+                        this->state = UI_AO_MEASURE_ANGLE_ST;
+                        TRIGGER_VOID_EVENT;
+                    break;
+                    }
                     case UI_AO_SW1_PRESSED_SIG:{
                         this->max_angle = prev_max_angle;
                         this->state = UI_AO_CONFIG_EXERCISE_ST;               
@@ -555,16 +634,14 @@ static void UI_dispatch(UI * const this, //dispatch se ejecuta siempre
                 switch(e->sig){
                     case UI_AO_TIMEOUT_SIG:{                        
                         prev_min_angle = this->min_angle;
-                        sprintf(char_data,"%ld", this->min_angle/10);
-                        change_string(modified_buffer, 0, char_data);
-                        display_rows("  Set min. angle:   ", "--------------------", "                    ", modified_buffer);                       
+                        put_angle(modified_buffer, this->min_angle, false);
+                        display_rows("  Set min. angle:   ", "--------------------", "Pause key: by hand  ", modified_buffer);                       
                     break;
                     }
                     case UI_AO_SW3_PRESSED_SIG:{
                         if(this->min_angle < 900){
                             this->min_angle+=delta_angle;
-                            sprintf(char_data,"%ld", this->min_angle/10);
-                            change_string(modified_buffer, 0, char_data);
+                            put_angle(modified_buffer, this->min_angle, false);
                             display_row4(modified_buffer);                            
                         }                      
                                            
@@ -573,21 +650,25 @@ static void UI_dispatch(UI * const this, //dispatch se ejecuta siempre
                     case UI_AO_SW2_PRESSED_SIG:{
                         if(this->min_angle > -900){
                             this->min_angle-=delta_angle;
-                            sprintf(char_data,"%ld", this->min_angle/10);
-                            change_string(modified_buffer, 0, char_data);
+                            put_angle(modified_buffer, this->min_angle, false);
                             display_row4(modified_buffer);
                         }                       
                                            
                     break;
                     }
                     case UI_AO_SW4_PRESSED_SIG:{
-                        sprintf(char_data,"%ld", this->min_angle/10);
-                        change_string(CONFIG_EXERCISE.options[1], 13, char_data);
+                        Text_put_int(config_rows[1], 13, this->min_angle/10);
                         i = 0;
                         this->state = UI_AO_CONFIG_EXERCISE_ST; 
                         TRIGGER_VOID_EVENT;                                           
                     break;
                     }               
+                    case UI_AO_SW5_PRESSED_SIG:{
+                        // Free the axis and read the angle it is moved to
+                        this->state = UI_AO_MEASURE_ANGLE_ST;
+                        TRIGGER_VOID_EVENT;
+                    break;
+                    }
                     case UI_AO_SW1_PRESSED_SIG:{
                         this->min_angle = prev_min_angle;
                         this->state = UI_AO_CONFIG_EXERCISE_ST;               
@@ -606,71 +687,51 @@ static void UI_dispatch(UI * const this, //dispatch se ejecuta siempre
                 switch (e->sig){
                     
                     case UI_AO_TIMEOUT_SIG:{ 
-                        display_rows(" Move to min. angle ", "if ready press enter", "--------------------", "                    ");                       
-                        if(angle == 0){
-                            display_row1(" Move to min. angle ");                            
-                        }
-                        else if(angle == 1){
-                            display_row1(" Move to max. angle ");
-                        }
-                        
-                        if(this->exercise_type == 0){                            
-                            // Liberamos motor de la manivela
-                            static Event free_motor2_event = {MOTORS_AO_FREE_M2_SIG};
-                            Active_post(AO_Motors, (Event*)&free_motor2_event);      
+                        if(!measuring){
+                            display_rows(" Move to min. angle ", "if ready press enter", "--------------------", "                    ");                       
+                            if(angle == 0){
+                                display_row1(" Move to min. angle ");                            
+                            }
+                            else if(angle == 1){
+                                display_row1(" Move to max. angle ");
+                            }
                             
-                            // Request para el ángulo del disco
-                            static Event rq_motor2_event = {MOTORS_AO_RQ_DEG_M2_SIG};
-                            Active_post(AO_Motors, (Event*)&rq_motor2_event);       
+                            if(this->exercise_type == 0){                            
+                                // Liberamos motor de la manivela
+                                static Event free_motor2_event = {MOTORS_AO_FREE_M2_SIG};
+                                Active_post(AO_Motors, (Event*)&free_motor2_event);      
+                            }
+                            else{                            
+                                // Liberamos motor de la base
+                                static Event free_motor1_event = {MOTORS_AO_FREE_M1_SIG};
+                                Active_post(AO_Motors, (Event*)&free_motor1_event);  
+                            }
+                            measuring = true;
+                            shown_angle = INT16_MIN;
                         }
-                        else{                            
-                            // Liberamos motor de la base
-                            static Event free_motor1_event = {MOTORS_AO_FREE_M1_SIG};
-                            Active_post(AO_Motors, (Event*)&free_motor1_event);  
-
-                            //Request para el ángulo de la base
-                            static Event rq_motor1_event = {MOTORS_AO_RQ_DEG_M1_SIG};
-                            Active_post(AO_Motors, (Event*)&rq_motor1_event); 
+                        else{
+                            // Sampled from the motors snapshot, no request needed
+                            new_angle = measured_angle(this);
+                            if(new_angle != shown_angle){
+                                shown_angle = new_angle;
+                                put_angle(modified_buffer, new_angle, true);
+                                display_row4(modified_buffer);
+                            }
                         }
+                        TimeEvent_arm(&this->te, (UI_MEASURE_REFRESH_MS / portTICK_RATE_MS), 0U);
                     break;
                     }      
-                    case UI_AO_ACK_DEG_M1_SIG:{
-                        printf("Ack received from motors deg M1\n");
-                        new_angle = (((UI_AO_ANGLE_PL*)e)->angle);
-                        printf("Angle received M1: %d", new_angle);
-                        sprintf(char_data,"%ld", new_angle/10);
-                        change_string(modified_buffer, 0, char_data);
-                        display_row4(modified_buffer);
-                        vTaskDelay(50 / portTICK_PERIOD_MS);
-                        static Event rq_motor1_event2 = {MOTORS_AO_RQ_DEG_M1_SIG};
-                        Active_post(AO_Motors, (Event*)&rq_motor1_event2);   
-                                            
-                    break;
-                    }   
-                    case UI_AO_ACK_DEG_M2_SIG:{
-                        printf("Ack received from motors deg M2\n");
-                        new_angle = (((UI_AO_ANGLE_PL*)e)->angle);
-                        printf("Angle received M2: %d", new_angle);
-                        sprintf(char_data,"%ld", new_angle/10);
-                        change_string(modified_buffer, 0, char_data);
-                        display_row4(modified_buffer);
-                        vTaskDelay(50 / portTICK_PERIOD_MS);
-                        static Event rq_motor2_event2 = {MOTORS_AO_RQ_DEG_M2_SIG};
-                        Active_post(AO_Motors, (Event*)&rq_motor2_event2);                          
-                    break;
-                    }           
-                    
                     case UI_AO_SW4_PRESSED_SIG:{
+                        new_angle = measured_angle(this);
+                        measuring = false;
                         printf("Enter pressed\nAngle to save: %d\n", new_angle);
                         if(angle == 0){                            
                             this->min_angle = new_angle;
-                            sprintf(char_data,"%ld", this->min_angle/10);
-                            change_string(CONFIG_EXERCISE.options[1], 13, char_data);
+                            Text_put_int(config_rows[1], 13, this->min_angle/10);
                         }
                         else if(angle == 1){
                             this->max_angle = new_angle;
-                            sprintf(char_data,"%ld", this->max_angle/10);
-                            change_string(CONFIG_EXERCISE.options[2], 13, char_data);
+                            Text_put_int(config_rows[2], 13, this->max_angle/10);
                         }
                         if(this->exercise_type == 0){
                             static Event block_motor2_event = {MOTORS_AO_BLOCK_M2_SIG};
@@ -686,6 +747,7 @@ static void UI_dispatch(UI * const this, //dispatch se ejecuta siempre
                     }               
                     case UI_AO_SW1_PRESSED_SIG:{
                         this->state = UI_AO_CONFIG_EXERCISE_ST; 
+                        measuring = false;
                         if(this->exercise_type == 0){
                             static Event block_motor2_event2 = {MOTORS_AO_BLOCK_M2_SIG};
                             Active_post(AO_Motors, (Event*)&block_motor2_event2);                        
@@ -709,16 +771,14 @@ static void UI_dispatch(UI * const this, //dispatch se ejecuta siempre
                     
                     case UI_AO_TIMEOUT_SIG:{                        
                         prev_time = this->time_in_position;
-                        sprintf(char_data,"%ld", this->time_in_position);
-                        change_string(modified_buffer, 0, char_data);
+                        Text_put_int(modified_buffer, 0, this->time_in_position);
                         display_rows("    Set time in     ", "      seconds:      ", "--------------------", modified_buffer);
                     break;
                     }
                     case UI_AO_SW3_PRESSED_SIG:{
                         if(this->time_in_position <this->max_secs){
                             this->time_in_position++;
-                            sprintf(char_data,"%ld", this->time_in_position);
-                            change_string(modified_buffer, 0, char_data);
+                            Text_put_int(modified_buffer, 0, this->time_in_position);
                             display_row4(modified_buffer);
                         }
                     break;
@@ -726,15 +786,13 @@ static void UI_dispatch(UI * const this, //dispatch se ejecuta siempre
                     case UI_AO_SW2_PRESSED_SIG:{
                         if(this->time_in_position > 1){
                             this->time_in_position--;
-                            sprintf(char_data,"%ld", this->time_in_position);
-                            change_string(modified_buffer, 0, char_data);
+                            Text_put_int(modified_buffer, 0, this->time_in_position);
                             display_row4(modified_buffer);
                         }                      
                     break;
                     }
                     case UI_AO_SW4_PRESSED_SIG:{
-                        sprintf(char_data,"%ld", this->time_in_position);
-                        change_string(CONFIG_EXERCISE.options[3], 7, char_data);
+                        Text_put_int(config_rows[3], 7, this->time_in_position);
                         i = 0;
                         this->state = UI_AO_CONFIG_EXERCISE_ST; 
                         TRIGGER_VOID_EVENT;                                           
@@ -753,13 +811,59 @@ static void UI_dispatch(UI * const this, //dispatch se ejecuta siempre
             break;
             }
 
+            case UI_AO_SPEED_ST:{              
+
+                switch (e->sig){
+                    
+                    case UI_AO_TIMEOUT_SIG:{                        
+                        prev_speed = this->speed;
+                        Text_put_int(modified_buffer, 0, this->speed);
+                        display_rows("    Set speed in    ", "   degrees/second:  ", "--------------------", modified_buffer);
+                    break;
+                    }
+                    case UI_AO_SW3_PRESSED_SIG:{
+                        if(this->speed < this->max_speed){
+                            this->speed += 5;
+                            Text_put_int(modified_buffer, 0, this->speed);
+                            display_row4(modified_buffer);
+                        }
+                    break;
+                    }
+                    case UI_AO_SW2_PRESSED_SIG:{
+                        if(this->speed > 5){
+                            this->speed -= 5;
+                            Text_put_int(modified_buffer, 0, this->speed);
+                            display_row4(modified_buffer);
+                        }                      
+                    break;
+                    }
+                    case UI_AO_SW4_PRESSED_SIG:{
+                        Text_put_int(config_rows[4], 16, this->speed);
+                        i = 0;
+                        this->state = UI_AO_CONFIG_EXERCISE_ST; 
+                        TRIGGER_VOID_EVENT;                                           
+                    break;
+                    }               
+                    case UI_AO_SW1_PRESSED_SIG:{
+                        this->speed = prev_speed;
+                        this->state = UI_AO_CONFIG_EXERCISE_ST;               
+                        i = 0;
+                        TRIGGER_VOID_EVENT;                                           
+                    break;
+                    }
+                    default:
+                        break;
+                }
+            break;
+            }
+
             case UI_AO_EXERCISE_READY_ST:{
                 switch(e->sig){
                     case UI_AO_TIMEOUT_SIG:{ 
                         if(created_routine.num_ejercicios<10){ 
                             if(this->min_angle < this->max_angle){
                                 Exercise new_exercise = {this->exercise_type, this->reps, this->min_angle,
-                                                        this->max_angle, this->time_in_position};
+                                                        this->max_angle, this->time_in_position, this->speed};
                                 created_routine.ejercicios[created_routine.num_ejercicios] = new_exercise;
                                 created_routine.num_ejercicios++;
                                 change_string(modified_buffer, 0, "                    ");
@@ -774,6 +878,7 @@ static void UI_dispatch(UI * const this, //dispatch se ejecuta siempre
                                     printf("min: %d\n",created_routine.ejercicios[i].lim_min);
                                     printf("max: %d\n",created_routine.ejercicios[i].lim_max);
                                     printf("secs: %d\n",created_routine.ejercicios[i].time_pos);
+                                    printf("speed: %d\n",created_routine.ejercicios[i].speed);
                                 }                       
                             }
                             else{
@@ -808,16 +913,16 @@ static void UI_dispatch(UI * const this, //dispatch se ejecuta siempre
                         }
                         else{
                             routine_to_do = created_routine;
-                            display_inicio(BEGIN_ROUTINE);
+                            display_inicio(&BEGIN_ROUTINE);
                         }
                     break;
                     }
                     case UI_AO_SW3_PRESSED_SIG:{
-                        display_plus_button(BEGIN_ROUTINE);                                           
+                        display_plus_button(&BEGIN_ROUTINE);                                           
                     break;
                     }
                     case UI_AO_SW2_PRESSED_SIG:{
-                        display_minus_button(BEGIN_ROUTINE);                                           
+                        display_minus_button(&BEGIN_ROUTINE);                                           
                     break;
                     }
                     case UI_AO_SW4_PRESSED_SIG:{
@@ -862,16 +967,14 @@ static void UI_dispatch(UI * const this, //dispatch se ejecuta siempre
                 switch(e->sig){
                     case UI_AO_TIMEOUT_SIG:{                        
                         prev_pause = this->pause_between_exercises;
-                        sprintf(char_data,"%ld", this->pause_between_exercises);
-                        change_string(modified_buffer, 0, char_data);
+                        Text_put_int(modified_buffer, 0, this->pause_between_exercises);
                         display_rows(" Set pause between  ", " exercises in secs: ", "--------------------", modified_buffer);
                     break;
                     }
                     case UI_AO_SW3_PRESSED_SIG:{
                         if(this->pause_between_exercises <this->max_pause){
                             this->pause_between_exercises++;
-                            sprintf(char_data,"%ld", this->pause_between_exercises);
-                            change_string(modified_buffer, 0, char_data);
+                            Text_put_int(modified_buffer, 0, this->pause_between_exercises);
                             display_row4(modified_buffer);
                         }
                     break;
@@ -879,8 +982,7 @@ static void UI_dispatch(UI * const this, //dispatch se ejecuta siempre
                     case UI_AO_SW2_PRESSED_SIG:{
                         if(this->pause_between_exercises > 1){
                             this->pause_between_exercises--;
-                            sprintf(char_data,"%ld", this->pause_between_exercises);
-                            change_string(modified_buffer, 0, char_data);
+                            Text_put_int(modified_buffer, 0, this->pause_between_exercises);
                             display_row4(modified_buffer);
                         }                      
                     break;
@@ -911,15 +1013,15 @@ static void UI_dispatch(UI * const this, //dispatch se ejecuta siempre
                 switch(e->sig){
                     case UI_AO_TIMEOUT_SIG:{                        
                         routine_to_do = default_routine;
-                        display_inicio(DO_DEFAULT);                        
+                        display_inicio(&DO_DEFAULT);                        
                     break;
                     }
                     case UI_AO_SW3_PRESSED_SIG:{
-                        display_plus_button(DO_DEFAULT);                                           
+                        display_plus_button(&DO_DEFAULT);                                           
                     break;
                     }
                     case UI_AO_SW2_PRESSED_SIG:{
-                        display_minus_button(DO_DEFAULT);                                           
+                        display_minus_button(&DO_DEFAULT);                                           
                     break;
                     }
                     case UI_AO_SW4_PRESSED_SIG:{
@@ -954,15 +1056,15 @@ static void UI_dispatch(UI * const this, //dispatch se ejecuta siempre
             case UI_AO_CHECK_ROUTINE_ST:{
                 switch(e->sig){
                     case UI_AO_TIMEOUT_SIG:{
-                        display_inicio(CHECK_ROUTINE);                        
+                        display_inicio(&CHECK_ROUTINE);                        
                     break;
                     }
                     case UI_AO_SW3_PRESSED_SIG:{
-                        display_plus_button(CHECK_ROUTINE);                                           
+                        display_plus_button(&CHECK_ROUTINE);                                           
                     break;
                     }
                     case UI_AO_SW2_PRESSED_SIG:{
-                        display_minus_button(CHECK_ROUTINE);                                           
+                        display_minus_button(&CHECK_ROUTINE);                                           
                     break;
                     }
                     case UI_AO_SW4_PRESSED_SIG:{
@@ -996,8 +1098,7 @@ static void UI_dispatch(UI * const this, //dispatch se ejecuta siempre
             case UI_AO_SEE_PAUSE_ST:{
                 switch(e->sig){
                     case UI_AO_TIMEOUT_SIG:{
-                        sprintf(char_data,"%ld", routine_to_do.pause);
-                        change_string(modified_buffer, 0, char_data);
+                        Text_put_int(modified_buffer, 0, routine_to_do.pause);
                         display_rows("   Pause  between   ","    exercises in    ", "      seconds:      ", modified_buffer);                   
                     break;
                     }
@@ -1019,16 +1120,16 @@ static void UI_dispatch(UI * const this, //dispatch se ejecuta siempre
                             display_rows("See exercises:      ", "--------------------", "*Exercise 1         ", "                    ");
                         }
                         else{
-                            display_inicio(SHOW_EXERCISES);
+                            display_inicio(&SHOW_EXERCISES);
                         }               
                     break;
                     }
                     case UI_AO_SW3_PRESSED_SIG:{
-                        display_plus_button(SHOW_EXERCISES);                                         
+                        display_plus_button(&SHOW_EXERCISES);                                         
                     break;
                     }
                     case UI_AO_SW2_PRESSED_SIG:{
-                        display_minus_button(SHOW_EXERCISES);                                         
+                        display_minus_button(&SHOW_EXERCISES);                                         
                     break;
                     }
                     case UI_AO_SW4_PRESSED_SIG:{
@@ -1052,26 +1153,22 @@ static void UI_dispatch(UI * const this, //dispatch se ejecuta siempre
             case UI_AO_SEE_AN_EXERCISE_ST:{
                 switch(e->sig){
                     case UI_AO_TIMEOUT_SIG:{
-                        sprintf(char_data,"%ld", selected_exercise + 1);
-                        change_string(SHOW_AN_EXERCISE.title, 10, char_data);
-                        change_string(SHOW_AN_EXERCISE.options[0], 7, availableExercises[routine_to_do.ejercicios[selected_exercise].type_of_exercise]);
-                        sprintf(char_data,"%ld", routine_to_do.ejercicios[selected_exercise].num_of_reps);
-                        change_string(SHOW_AN_EXERCISE.options[1], 14, char_data);
-                        sprintf(char_data,"%ld", routine_to_do.ejercicios[selected_exercise].lim_min/10);
-                        change_string(SHOW_AN_EXERCISE.options[2], 13, char_data);
-                        sprintf(char_data,"%ld", routine_to_do.ejercicios[selected_exercise].lim_max/10);
-                        change_string(SHOW_AN_EXERCISE.options[3], 13, char_data);
-                        sprintf(char_data,"%ld", routine_to_do.ejercicios[selected_exercise].time_pos);
-                        change_string(SHOW_AN_EXERCISE.options[4], 7, char_data);
-                        display_inicio(SHOW_AN_EXERCISE);
+                        Text_put_int(exercise_title, 10, selected_exercise + 1);
+                        change_string(exercise_rows[0], 7, availableExercises[routine_to_do.ejercicios[selected_exercise].type_of_exercise]);
+                        Text_put_int(exercise_rows[1], 14, routine_to_do.ejercicios[selected_exercise].num_of_reps);
+                        Text_put_int(exercise_rows[2], 13, routine_to_do.ejercicios[selected_exercise].lim_min/10);
+                        Text_put_int(exercise_rows[3], 13, routine_to_do.ejercicios[selected_exercise].lim_max/10);
+                        Text_put_int(exercise_rows[4], 7, routine_to_do.ejercicios[selected_exercise].time_pos);
+                        Text_put_int(exercise_rows[5], 16, routine_to_do.ejercicios[selected_exercise].speed);
+                        display_inicio(&SHOW_AN_EXERCISE);
                     break;
                     }
                     case UI_AO_SW3_PRESSED_SIG:{
-                        display_plus_button(SHOW_AN_EXERCISE);                                         
+                        display_plus_button(&SHOW_AN_EXERCISE);                                         
                     break;
                     }
                     case UI_AO_SW2_PRESSED_SIG:{
-                        display_minus_button(SHOW_AN_EXERCISE);                                         
+                        display_minus_button(&SHOW_AN_EXERCISE);                                         
                     break;
                     }
                     case UI_AO_SW1_PRESSED_SIG:{
@@ -1094,6 +1191,7 @@ static void UI_dispatch(UI * const this, //dispatch se ejecuta siempre
                     }
                     case UI_AO_SW4_PRESSED_SIG:{
                         this->state = UI_AO_COUNTDOWN_ST;
+                        counter = 3;
                         TRIGGER_VOID_EVENT;
                     break;
                     }
@@ -1105,16 +1203,23 @@ static void UI_dispatch(UI * const this, //dispatch se ejecuta siempre
             case UI_AO_COUNTDOWN_ST:{
                 switch(e->sig){
                     case UI_AO_TIMEOUT_SIG:{
-                        inExercise = true;
                         if(counter == 0){
                             change_string(modified_buffer, 0, "GO!");
                             display_row4(modified_buffer);
-                            this->state = UI_AO_MOVE_BAR_ST;
-                            TimeEvent_arm(&this->te, (1500 / portTICK_RATE_MS), 0U);
+                            // The whole routine runs in the motors AO
+                            static MOTORS_AO_PLAN_PL plan_event = {MOTORS_AO_RUN_PLAN_SIG, &routine_plan};
+                            if(!Motion_plan_compile(&routine_plan, &routine_to_do)){
+                                display_rows("    Error occured   ", " Routine too long   ", "                    ", "                    ");
+                                this->state = UI_AO_INICIO_ST;
+                                TimeEvent_arm(&this->te, (2000 / portTICK_RATE_MS), 0U);
+                                break;
+                            }
+                            Active_post(AO_Motors, (Event*)&plan_event);
+                            inExercise = true;
+                            this->state = UI_AO_RUN_ROUTINE_ST;
                         }
                         else{
-                        sprintf(char_data,"%ld", counter);
-                        change_string(modified_buffer, 0, char_data);
+                        Text_put_int(modified_buffer, 0, counter);
                         display_rows("                    ", "Beginning routine in", "                    ", modified_buffer);
                         counter--;
                         TimeEvent_arm(&this->te, (1000 / portTICK_RATE_MS), 0U);
@@ -1126,261 +1231,96 @@ static void UI_dispatch(UI * const this, //dispatch se ejecuta siempre
                 }
             break;
             }
-             case UI_AO_CENTER_DEVICE_ST:{
+             case UI_AO_RUN_ROUTINE_ST:{
                 switch(e->sig){
-                    case UI_AO_TIMEOUT_SIG:{
-                        display_rows("      Centering     ", "       device       ", "                    ", "                    ");
-                        static MOTORS_AO_MOVE_PL center_movement_event = {MOTORS_AO_MOVE_SIG, M1, 0};
-                        Active_post(AO_Motors, (Event*)&center_movement_event);                     
-                        
-                    break;
-                    }
-                    case UI_AO_ACK_MOVE_SIG:{
-                        printf("ACK move center from motors received\n");
-                        this->state = UI_AO_END_OF_EXERCISE_ST;
-                        TRIGGER_VOID_EVENT; 
-                    break;
-                    }                     
-                    default:
-                        break;
-                }
-            break;
-            }
-            case UI_AO_MOVE_BAR_ST:{
-                switch(e->sig){
-                    case UI_AO_TIMEOUT_SIG:{
-                        if(routine_to_do.ejercicios[selected_exercise].type_of_exercise == 2){
-                            static MOTORS_AO_MOVE_PL horizontal_movement_event2 = {MOTORS_AO_MOVE_SIG, M2, -900};
-                            Active_post(AO_Motors, (Event*)&horizontal_movement_event2);
-                            display_rows("    Positioning     ", "         bar        ", "    horizontally    ", "                    ");  
-                        }
-                        else{
-                            static MOTORS_AO_MOVE_PL vertical_movement_event2 = {MOTORS_AO_MOVE_SIG, M2, 0};
-                            Active_post(AO_Motors, (Event*)&vertical_movement_event2);
-                            display_rows("    Positioning     ", "         bar        ", "     vertically     ", "                    ");
-                        }
-                        inicio = true;
-                    break;  
-                    }
-                    case UI_AO_ACK_MOVE_SIG:{                                              
-                        this->state = UI_AO_MOVE_TO_MIN_ANGLE_ST;
-                        TimeEvent_arm(&this->te, (2000 / portTICK_RATE_MS), 0U);
-                        
-                    break;
-                    } 
-                    default:
-                        break;
-                }
-            break;
-            }    
-            case UI_AO_MOVE_TO_MIN_ANGLE_ST:{
-                switch ((e->sig)){
-                    case UI_AO_TIMEOUT_SIG:{                        
-                        if(inicio){    
-                            degrees_to_send = routine_to_do.ejercicios[selected_exercise].lim_min;
-                            printf("Degrees to send min: %d\n", degrees_to_send);                        
-                            change_string(modified_buffer, 0, "Ex. ");
-                            sprintf(char_data,"%ld", selected_exercise + 1);
-                            change_string(modified_buffer, 4, char_data);
-                            change_string(modified_buffer, 7, availableExercises[routine_to_do.ejercicios[selected_exercise].type_of_exercise]);
-                            display_row1(modified_buffer);
-                            display_row4("                    ");
-                            if(routine_to_do.ejercicios[selected_exercise].type_of_exercise == 0){
-                                
-                                static MOTORS_AO_MOVE_PL min_angle_M2_movement_event = {MOTORS_AO_MOVE_SIG, M2};
-                                min_angle_M2_movement_event.degrees = degrees_to_send;
-                                Active_post(AO_Motors, (Event*)&min_angle_M2_movement_event);
-                                display_row2("Min. Angle          ");
-
-                            }
-                            else{
-                                static MOTORS_AO_MOVE_PL min_angle_M1_movement_event = {MOTORS_AO_MOVE_SIG, M1};
-                                min_angle_M1_movement_event.degrees = degrees_to_send;
-                                Active_post(AO_Motors, (Event*)&min_angle_M1_movement_event);
-                                display_row2("Min. Angle          ");
-
+                    case UI_AO_PLAN_PROGRESS_SIG:{
+                        UI_AO_PLAN_PROGRESS_PL const* progress = (UI_AO_PLAN_PROGRESS_PL*)e;
+                        Exercise const* exercise = &routine_to_do.ejercicios[progress->exercise];
+                        plan_phase = progress->phase;
+                        counter = 0;
+                        TimeEvent_disarm(&this->te);
+
+                        switch(progress->phase){
+                            case MOTION_PLAN_POSITION_BAR:{
+                                if(progress->value == MOTION_PLAN_BAR_HORIZONTAL){
+                                    display_rows("    Positioning     ", "         bar        ", "    horizontally    ", "                    ");  
+                                }else{
+                                    display_rows("    Positioning     ", "         bar        ", "     vertically     ", "                    ");
+                                }
+                            break;
                             }
-                            change_string(modified_buffer, 0, "Current rep.: ");
-                            sprintf(char_data,"%ld", current_repetition + 1);
-                            change_string(modified_buffer, 14, char_data);
-                            display_row3(modified_buffer);  
-                            inicio = false;
-                            counter = routine_to_do.ejercicios[selected_exercise].time_pos;                            
-                        }
-                        else{
-                            if(counter>0){
-                                change_string(modified_buffer, 0, "Hold ");
-                                sprintf(char_data,"%ld", counter);
-                                change_string(modified_buffer, 5, char_data);
+                            case MOTION_PLAN_TO_MIN:
+                            case MOTION_PLAN_TO_MAX:
+                            case MOTION_PLAN_TO_START:
+                            case MOTION_PLAN_CIRCLE_PATH:{
+                                change_string(modified_buffer, 0, "Ex. ");
+                                Text_put_int(modified_buffer, 4, progress->exercise + 1);
+                                change_string(modified_buffer, 7, availableExercises[exercise->type_of_exercise]);
+                                display_row1(modified_buffer);
+                                if(progress->phase == MOTION_PLAN_TO_MIN){
+                                    display_row2("Min. Angle          ");
+                                }else if(progress->phase == MOTION_PLAN_TO_MAX){
+                                    display_row2("Max. Angle          ");
+                                }else if(progress->phase == MOTION_PLAN_TO_START){
+                                    display_row2("Start position      ");
+                                }else{
+                                    display_row2("Circle              ");
+                                }
+                                change_string(modified_buffer, 0, "Current rep.: ");
+                                Text_put_int(modified_buffer, 14, progress->rep + 1);
+                                display_row3(modified_buffer);
+                                // Repetitions done
+                                Lcd_bar_render(modified_buffer, 0, LCD_COLS, 
+                                               progress->rep, exercise->num_of_reps);
                                 display_row4(modified_buffer);
-                                counter--;
-                                TimeEvent_arm(&this->te, (1000/ portTICK_RATE_MS), 0U);
+                            break;
                             }
-                            else{
-                                this->state = UI_AO_MOVE_TO_MAX_ANGLE_ST;
-                                inicio = true;
-                                display_row4("                    ");
+                            case MOTION_PLAN_PAUSE:
+                                display_rows("    Pause before    ", "   next  exercise   ", "                    ", "                    ");
+                                // Jump to next event response
+                            case MOTION_PLAN_HOLD_MIN:
+                            case MOTION_PLAN_HOLD_MAX:{
+                                // Countdown display only, the plan owns the timing
+                                counter = progress->value / 1000;
+                                counter_total = counter;
                                 TRIGGER_VOID_EVENT;
+                            break;
                             }
-                        }
-                        
-                    break;  
-                    }
-                    case UI_AO_ACK_MOVE_SIG:{
-                        printf("ACK MIN POS\n");
-                        TRIGGER_VOID_EVENT; 
-                    break;
-                    } 
-                    default:
-                        break;
-                }            
-            break;
-            }
-            case UI_AO_MOVE_TO_MAX_ANGLE_ST:{
-                switch(e->sig){
-                    case UI_AO_TIMEOUT_SIG:{                        
-                        if(inicio){
-                            degrees_to_send = routine_to_do.ejercicios[selected_exercise].lim_max;
-                            printf("Degrees to send max: %d\n", degrees_to_send);
-                            if(routine_to_do.ejercicios[selected_exercise].type_of_exercise == 0){
-                                static MOTORS_AO_MOVE_PL max_angle_M2_movement_event = {MOTORS_AO_MOVE_SIG,M2};
-                                max_angle_M2_movement_event.degrees = degrees_to_send;
-                                Active_post(AO_Motors, (Event*)&max_angle_M2_movement_event);
-                                display_row2("Max. Angle          ");                                
-                            }
-                            else{
-                                static MOTORS_AO_MOVE_PL max_angle_M1_movement_event = {MOTORS_AO_MOVE_SIG, M1};
-                                max_angle_M1_movement_event.degrees = degrees_to_send;
-                                Active_post(AO_Motors, (Event*)&max_angle_M1_movement_event);                                
-                                display_row2("Max. Angle          ");
-
-                            } 
-                            inicio = false;
-                            counter = routine_to_do.ejercicios[selected_exercise].time_pos;
-                        }
-                        else{
-                            if(counter>0){
-                                change_string(modified_buffer, 0, "Hold ");
-                                sprintf(char_data,"%ld", counter);
-                                change_string(modified_buffer, 5, char_data);
-                                display_row4(modified_buffer);
-                                counter--;
-                                TimeEvent_arm(&this->te, (1000/ portTICK_RATE_MS), 0U);
+                            case MOTION_PLAN_CENTER:{
+                                display_rows("      Centering     ", "       device       ", "                    ", "                    ");
+                            break;
                             }
-                            else{
-                                this->state = UI_AO_END_OF_REPETITION_ST;
-                                inicio = true;
-                                TRIGGER_VOID_EVENT;
+                            case MOTION_PLAN_FINISHED:{
+                                display_rows("   End of routine   ", "                    ", "   Well done!  :D   ", "                    ");
+                                inExercise = false;
+                                this->state = UI_AO_INICIO_ST;
+                                TimeEvent_arm(&this->te, (2000/ portTICK_RATE_MS), 0U);
+                            break;
                             }
-                        }
-                        
-                    break;  
-                    }
-                    case UI_AO_ACK_MOVE_SIG:{
-                        printf("ACK MAX POS\n");
-                        TRIGGER_VOID_EVENT; 
-                    break;
-                    } 
-                    default:
-                        break;
-                }
-
-            break;
-            }
-            case UI_AO_END_OF_REPETITION_ST:{
-                switch(e->sig){
-                    case UI_AO_TIMEOUT_SIG:{
-                        if(current_repetition + 1 < routine_to_do.ejercicios[selected_exercise].num_of_reps){
-                            current_repetition++;
-                            this->state = UI_AO_MOVE_TO_MIN_ANGLE_ST;
-                            TRIGGER_VOID_EVENT;
-                        }
-                        else if(selected_exercise + 1 < routine_to_do.num_ejercicios){
-                            selected_exercise ++;
-                            current_repetition = 0;
-                            counter = routine_to_do.pause;
-                            this->state = UI_AO_CENTER_DEVICE_ST;
-                            TRIGGER_VOID_EVENT;                            
-                        }
-                        else{
-                            
-                            this->state = UI_AO_END1_ST;
-                            TimeEvent_arm(&this->te, (1000/ portTICK_RATE_MS), 0U);
+                            default:
+                                break;
                         }
                     break;
                     }
-                    default:
-                        break;
-                }
-            break;
-            }
-            case UI_AO_END_OF_EXERCISE_ST:{
-                switch(e->sig){
                     case UI_AO_TIMEOUT_SIG:{
-                        display_rows("    Pause before    ", "   next  exercise   ", "                    ", "                    ");
                         if(counter>0){
-                            change_string(modified_buffer, 0, "Beginning in ");
-                            sprintf(char_data,"%ld", counter);
-                            change_string(modified_buffer, 13, char_data);
+                            if(plan_phase == MOTION_PLAN_PAUSE){
+                                change_string(modified_buffer, 0, "Beginning in ");
+                                Text_put_int(modified_buffer, 13, counter);
+                            }else{
+                                change_string(modified_buffer, 0, "Hold ");
+                                Text_put_int(modified_buffer, 5, counter);
+                                // Time left
+                                Lcd_bar_render(modified_buffer, UI_HOLD_BAR_COL,
+                                               LCD_COLS - UI_HOLD_BAR_COL,
+                                               counter, counter_total);
+                            }
                             display_row4(modified_buffer);
                             counter--;
                             TimeEvent_arm(&this->te, (1000/ portTICK_RATE_MS), 0U);
                         }
-                        else{
-                            this->state = UI_AO_MOVE_BAR_ST;                                
-                            TRIGGER_VOID_EVENT;
-                        }
                     break;
                     }
-
-
-                    default:
-                        break;
-                }
-            break;
-            }
-            case UI_AO_END1_ST:{
-                switch(e->sig){
-                    case UI_AO_TIMEOUT_SIG:{                        
-                        static MOTORS_AO_MOVE_PL center_movement_event_end = {MOTORS_AO_MOVE_SIG, M1, 0};
-                        Active_post(AO_Motors, (Event*)&center_movement_event_end);                     
-                        
-                    break;
-                    }
-                    case UI_AO_ACK_MOVE_SIG:{
-                        printf("ACK move center from motors received\n");
-                        this->state = UI_AO_END2_ST;
-                        TRIGGER_VOID_EVENT; 
-                    break;
-                    }                     
-                    default:
-                        break;
-                }
-            break;
-            }
-            case UI_AO_END2_ST:{
-                switch(e->sig){
-                    case UI_AO_TIMEOUT_SIG:{
-                        if(routine_to_do.ejercicios[selected_exercise-1].type_of_exercise == 2){
-                            static MOTORS_AO_MOVE_PL horizontal_movement_event_end = {MOTORS_AO_MOVE_SIG, M2, -900};
-                            Active_post(AO_Motors, (Event*)&horizontal_movement_event_end);
-                            
-                        }
-                        else{
-                            static MOTORS_AO_MOVE_PL vertical_movement_event_end = {MOTORS_AO_MOVE_SIG, M2, 0};
-                            Active_post(AO_Motors, (Event*)&vertical_movement_event_end);
-                            
-                        }
-                        inicio = true;
-                    break;  
-                    }
-                    case UI_AO_ACK_MOVE_SIG:{                                              
-                        display_rows("   End of routine   ", "                    ", "   Well done!  :D   ", "                    ");
-                        this->state = UI_AO_INICIO_ST;
-                        TimeEvent_arm(&this->te, (2000/ portTICK_RATE_MS), 0U);
-
-                    break;
-                    }                     
                     default:
                         break;
                 }
@@ -1393,81 +1333,127 @@ static void UI_dispatch(UI * const this, //dispatch se ejecuta siempre
 }
 
 
-void display_rows(char text1[20], char text2[20], char text3[20], char text4[20]){
-    display_row1(text1);
-    display_row2(text2);
-    display_row3(text3);
-    display_row4(text4);
+void display_rows(char const* text1, char const* text2, char const* text3,
+                  char const* text4){
+    char const* const rows[LCD_ROWS] = {text1, text2, text3, text4};
+    Printer_post_frame(AO_printer, rows);
 }
 
-void display_row1(char text[20]){
-    static PRINTER_AO_TEXT_PL print_sw1_event = {PRINTER_AO_TEXT0_SIG};
-    sprintf(print_sw1_event.string_buffer, "%.20s",text);
-    Active_post(AO_printer, (Event*)&print_sw1_event);
+void display_row1(char const* text){
+    Printer_post_row(AO_printer, 0, text);
 }
-void display_row2(char text[20]){
-    static PRINTER_AO_TEXT_PL print_sw2_event = {PRINTER_AO_TEXT1_SIG};
-    sprintf(print_sw2_event.string_buffer, "%.20s",text);
-    Active_post(AO_printer, (Event*)&print_sw2_event);
+void display_row2(char const* text){
+    Printer_post_row(AO_printer, 1, text);
 }
-void display_row3(char text[20]){
-    static PRINTER_AO_TEXT_PL print_sw3_event = {PRINTER_AO_TEXT2_SIG};
-    sprintf(print_sw3_event.string_buffer, "%.20s",text);
-    Active_post(AO_printer, (Event*)&print_sw3_event);
+void display_row3(char const* text){
+    Printer_post_row(AO_printer, 2, text);
 }
-void display_row4(char text[20]){
-    static PRINTER_AO_TEXT_PL print_sw4_event = {PRINTER_AO_TEXT3_SIG};
-    sprintf(print_sw4_event.string_buffer, "%.20s",text);
-    Active_post(AO_printer, (Event*)&print_sw4_event);
+void display_row4(char const* text){
+    Printer_post_row(AO_printer, 3, text);
 }
 
-void change_string(char base[], int l, char addition[]){
-    int k = strlen(addition);
-    for(int i = l; i < l+k; i++){
-        base[i] = addition[i-l];
-    }
-    for(int i = l+k; i < 20; i++){
-        base[i] = ' ';
-    }
+void change_string(char base[], int l, char const* addition){
+    Text_put(base, l, addition);
 }
 
-void display_inicio(UI_State estado){
-    display_row1(estado.title);
-    display_row2("--------------------");
-    select_option(estado.options[i]);
-    display_row3(modified_buffer);
-    display_row4(estado.options[i+1]);
+void display_inicio(UI_Menu const* menu){
+    select_option(menu->options[i]);
+    display_rows(menu->title, "--------------------", modified_buffer,
+                 i + 1 < menu->num_of_options ? menu->options[i+1] 
+                                               : "                    ");
 }
 
 
-void display_plus_button(UI_State estado){    
-    if(i <  estado.num_of_options-1){
-        select_option(estado.options[i+1]);
-        display_row3(estado.options[i]);
-        display_row4(modified_buffer);
+void display_plus_button(UI_Menu const* menu){    
+    if(i + 1 < menu->num_of_options){
+        select_option(menu->options[i+1]);
+        char const* const rows[LCD_ROWS] = {NULL, NULL, menu->options[i],
+                                            modified_buffer};
+        Printer_post_frame(AO_printer, rows);
         i++;        
     }  
 }
-void display_minus_button(UI_State estado){    
+void display_minus_button(UI_Menu const* menu){    
     if(i > 0){
-        select_option(estado.options[i-1]);
-        display_row3(modified_buffer);
-        display_row4(estado.options[i]);
+        select_option(menu->options[i-1]);
+        char const* const rows[LCD_ROWS] = {NULL, NULL, modified_buffer,
+                                            menu->options[i]};
+        Printer_post_frame(AO_printer, rows);
         i--;        
     }  
 }                
 
-void select_option(char option[20]){
+void select_option(char const* option){
     memcpy(modified_buffer, option, 20);
     modified_buffer[0] = '*';
 }
 
+/**
+ * @brief Write an angle and its bar over -90..90 deg to a row
+ *
+ * @param tenths Show tenths of degree, whole degrees otherwise
+ */
+static void put_angle(char* row, int32_t deg10, bool tenths){
+    if(tenths){
+        Text_put_deg10(row, 0, deg10);
+    }else{
+        Text_put_int(row, 0, deg10/10);
+    }
+    Lcd_bar_render(row, UI_ANGLE_BAR_COL, LCD_COLS - UI_ANGLE_BAR_COL,
+                   deg10 + UI_ANGLE_BAR_SPAN, 2 * UI_ANGLE_BAR_SPAN);
+}
 
+// Angle of the freed axis from the motors snapshot, the last good copy is
+// kept if a read was torn. Clamped to the span of the bar and of the limits.
+static int16_t measured_angle(UI const * const this){
+    static Motors_Snapshot_Data motors;
+    Axis_Id measured = this->exercise_type == 0 ? AXIS_M2 : AXIS_M1;
+    int32_t angle;
+
+    Motors_snapshot_read(&motors_snapshot, &motors);
+    angle = motors.axes[measured].measured;
+    if(angle > UI_ANGLE_BAR_SPAN){
+        angle = UI_ANGLE_BAR_SPAN;
+    }else if(angle < -UI_ANGLE_BAR_SPAN){
+        angle = -UI_ANGLE_BAR_SPAN;
+    }
+    return (int16_t)angle;
+}
 
+#if UI_FORMAT_BENCHMARK
+/**
+ * @brief Format the same values with text_format and with sprintf, print
+ * the cycles per call and the stack each one adds. Runs first in the UI task,
+ * so the stack high water mark is not yet set by deeper calls.
+ */
+static void UI_format_benchmark(void){
+    static const int32_t values[] = {0, 7, -90, 100, -1234, INT32_MAX};
+    uint8_t count = sizeof(values)/sizeof(values[0]);
+    uint32_t cycles_per_us = clock_get_hz(clk_sys) / 1000000;
+    char row[TEXT_ROW_LEN];
+    char buffer[TEXT_INT_MAX];
+
+    UBaseType_t free_start = uxTaskGetStackHighWaterMark(NULL);
+    uint32_t start_us = time_us_32();
+    for(uint16_t n = 0; n < UI_BENCHMARK_CALLS; n++){
+        Text_put_int(row, 13, values[n % count]);
+    }
+    uint32_t text_us = time_us_32() - start_us;
+    UBaseType_t free_text = uxTaskGetStackHighWaterMark(NULL);
 
-
-
-
-
-
-
+    start_us = time_us_32();
+    for(uint16_t n = 0; n < UI_BENCHMARK_CALLS; n++){
+        sprintf(buffer, "%ld", values[n % count]);
+        Text_put(row, 13, buffer);
+    }
+    uint32_t sprintf_us = time_us_32() - start_us;
+    UBaseType_t free_sprintf = uxTaskGetStackHighWaterMark(NULL);
+
+    printf("Format text_format: %lu cycles/call, %lu bytes of stack\n",
+           text_us * cycles_per_us / UI_BENCHMARK_CALLS,
+           (uint32_t)(free_start - free_text) * sizeof(StackType_t));
+    printf("Format sprintf: %lu cycles/call, %lu bytes of stack\n",
+           sprintf_us * cycles_per_us / UI_BENCHMARK_CALLS,
+           (uint32_t)(free_start - free_sprintf) * sizeof(StackType_t));
+}
+#endif
@@ -0,0 +1,163 @@
+/** 
+  ******************************************************************************
+  * @file    calib_flash.c
+  * @author  Camilo Vera
+  * @brief   Calibration storage
+  *          Keeps the mechanism calibration in the last flash sector so it
+  *          survives power cycles.
+  ****************************************************************************** 
+*/
+
+#include "calib_flash.h"
+
+/* Includes ------------------------------------------------------------------*/
+
+// Standard C libraries
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+
+// SDK Libraries
+#include "pico/stdlib.h"
+#include "hardware/flash.h"
+#include "hardware/sync.h"
+
+// Flash is memory mapped through XIP, one record per page
+#define CALIB_FLASH_RECORD(n) \
+    ((Calib_Data const*)(XIP_BASE + CALIB_FLASH_OFFSET + (n)*FLASH_PAGE_SIZE))
+
+static uint32_t calib_checksum(Calib_Data const* data){
+    uint8_t const* bytes = (uint8_t const*)data;
+    uint32_t crc = 0xFFFFFFFF;
+
+    for(size_t i = 0; i < offsetof(Calib_Data, checksum); i++){
+        crc ^= bytes[i];
+        for(uint8_t bit = 0; bit < 8; bit++){
+            crc = (crc >> 1) ^ (0xEDB88320 & -(crc & 1));
+        }
+    }
+    return ~crc;
+}
+
+static bool calib_valid(Calib_Data const* data){
+    return data->magic == CALIB_FLASH_MAGIC &&
+           data->version == CALIB_FLASH_VERSION &&
+           data->checksum == calib_checksum(data);
+}
+
+static bool calib_erased(Calib_Data const* data){
+    uint8_t const* bytes = (uint8_t const*)data;
+
+    for(size_t i = 0; i < sizeof(Calib_Data); i++){
+        if(bytes[i] != 0xFF){
+            return false;
+        }
+    }
+    return true;
+}
+
+// Newest valid record, records are written in page order
+static Calib_Data const* calib_last(void){
+    for(int8_t n = CALIB_FLASH_RECORDS - 1; n >= 0; n--){
+        if(calib_valid(CALIB_FLASH_RECORD(n))){
+            return CALIB_FLASH_RECORD(n);
+        }
+    }
+    return NULL;
+}
+
+// First erased page after the newest record, -1 if the sector is full
+static int8_t calib_free(void){
+    int8_t free = -1;
+
+    for(int8_t n = CALIB_FLASH_RECORDS - 1; n >= 0; n--){
+        if(!calib_erased(CALIB_FLASH_RECORD(n))){
+            break;
+        }
+        free = n;
+    }
+    return free;
+}
+
+// Zeros wrap at 4096 and jitter by a few counts between homings
+static bool calib_same(Calib_Data const* a, Calib_Data const* b){
+    if(a->mechanism_id != b->mechanism_id){
+        return false;
+    }
+    for(uint8_t i = 0; i < AXIS_COUNT; i++){
+        int32_t distance = ((int32_t)a->encoder_zero[i]
+                            - (int32_t)b->encoder_zero[i]) % 4096;
+        if(distance > 2048){
+            distance -= 4096;
+        }else if(distance < -2048){
+            distance += 4096;
+        }
+        if(distance > CALIB_FLASH_TOLERANCE || distance < -CALIB_FLASH_TOLERANCE){
+            return false;
+        }
+    }
+    return true;
+}
+
+void Calib_flash_init(void){
+    static uint8_t page[FLASH_PAGE_SIZE];
+    Calib_Data const* last = calib_last();
+
+    if(calib_free() >= 0){
+        return;
+    }
+
+    // Full sector, the newest record is kept in the first page
+    memset(page, 0xFF, sizeof(page));
+    if(last != NULL){
+        memcpy(page, last, sizeof(Calib_Data));
+    }
+    uint32_t interrupts = save_and_disable_interrupts();
+    flash_range_erase(CALIB_FLASH_OFFSET, FLASH_SECTOR_SIZE);
+    if(last != NULL){
+        flash_range_program(CALIB_FLASH_OFFSET, page, FLASH_PAGE_SIZE);
+    }
+    restore_interrupts(interrupts);
+}
+
+bool Calib_flash_load(Calib_Data* data, uint32_t mechanism_id){
+    Calib_Data const* last = calib_last();
+
+    if(last == NULL){
+        return false;
+    }
+    memcpy(data, last, sizeof(Calib_Data));
+    return data->mechanism_id == mechanism_id;
+}
+
+bool Calib_flash_save(Calib_Data* data){
+    static uint8_t page[FLASH_PAGE_SIZE];
+    Calib_Data const* last = calib_last();
+    int8_t free = calib_free();
+
+    data->magic = CALIB_FLASH_MAGIC;
+    data->version = CALIB_FLASH_VERSION;
+    data->reserved = 0;
+    data->checksum = calib_checksum(data);
+
+    // Avoid wearing the sector when nothing really changed
+    if(last != NULL && calib_same(data, last)){
+        return false;
+    }
+    if(free < 0){
+        return false;               // Made room for at the next boot
+    }
+
+    memset(page, 0xFF, sizeof(page));
+    memcpy(page, data, sizeof(Calib_Data));
+
+    // No code may run from flash while it is programmed, one page is ~1 ms
+    uint32_t interrupts = save_and_disable_interrupts();
+    flash_range_program(CALIB_FLASH_OFFSET + free*FLASH_PAGE_SIZE, page,
+                        FLASH_PAGE_SIZE);
+    restore_interrupts(interrupts);
+
+    return true;
+}
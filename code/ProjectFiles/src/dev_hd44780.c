@@ -1,161 +1,316 @@
-// Copyright 2021 Ocean (iiot2k@gmail.com) 
-// All rights reserved.
-
-#include <stdlib.h>
-#include <string.h>
-
-//#include "sys_time.h"
-
-#include "dev_hd44780.h"
-
-#include "hardware/i2c.h"
-
-// FreeRTOS
-#include <FreeRTOS.h>
-#include <task.h>
-
-#define LCD_CS  0x4
-#define LCD_LED 0x8
-
-
-static inline int32_t sys_i2c_wbyte(i2c_inst_t* i2c, uint8_t addr, uint8_t wb)
-{
-    return i2c_write_timeout_us(i2c, addr, &wb, 1, false, 500);
-}
-
-
-// write to hd44780 module
-static void hd44780_write(i2c_inst_t* i2c, uint8_t addr, uint8_t data, uint8_t rs)
-{
-    uint8_t data_h = (data & 0xF0) | LCD_LED | rs;
-    uint8_t data_l = (data << 4) | LCD_LED | rs;
-
-    // write high byte and pulse CD with negative edge
-
-    //i2c_write_blocking(i2c, addr, data_h / LCD_CS, 1, false);
-    
-    sys_i2c_wbyte(i2c, addr, data_h | LCD_CS);
-    running_wait_us(100);
-    //vTaskDelay(1);
-    //sleep_us(100); // cs setup time
-    sys_i2c_wbyte(i2c, addr, data_h);
-    running_wait_us(200);
-    //vTaskDelay(1); 
-    //sleep_us(200); // data hold time
-
-    // write low byte and pulse CD with negative edge
-    sys_i2c_wbyte(i2c, addr, data_l | LCD_CS);
-    running_wait_us(100);
-    //vTaskDelay(1);
-    //sleep_us(100); // cs setup time
-    sys_i2c_wbyte(i2c, addr, data_l);
-    running_wait_us(200);
-    //vTaskDelay(1);
-    //sleep_us(200); // data hold time
-}
-
-// write commend
-static void inline hd44780_cmd(i2c_inst_t* i2c, uint8_t addr, uint8_t data)
-{
-    hd44780_write(i2c, addr, data, 0);
-}
-
-// write data
-static void inline hd44780_data(i2c_inst_t* i2c, uint8_t addr, uint8_t data)
-{
-    hd44780_write(i2c, addr, data, 1);
-}
-
-void dev_hd44780_init(i2c_inst_t* i2c, uint8_t addr)
-{
-    // set interface to 4 bit
-    //sleep_ms(50);
-    //vTaskDelay(50);
-    init_wait_ms(50);
-    hd44780_cmd(i2c, addr, 0x03);
-    hd44780_cmd(i2c, addr, 0x03);
-    hd44780_cmd(i2c, addr, 0x03);
-    hd44780_cmd(i2c, addr, 0x02);
-
-    // set lcd register
-    hd44780_cmd(i2c, addr, 0x04 | 0x02); // increment DDRAM
-    hd44780_cmd(i2c, addr, 0x08 | 0x04); // display on
-    hd44780_cmd(i2c, addr, 0x20 | 0x08); // 4bit, 2 lines, 5x8 dots
-
-    // clear display
-    hd44780_cmd(i2c, addr, 0x01);
-    init_wait_ms(20);
-    //vTaskDelay(20);
-    //sleep_ms(20);
-}
-
-static uint8_t row_offsets[] = { 0x00, 0x40, 0x14, 0x54 };
-
-void dev_hd44780_text(i2c_inst_t* i2c, uint8_t addr, uint8_t line, bool is4line, uint8_t* txt)
-{
-     // 1602 has only two lines
-    if (!is4line && (line > 1))
-        return;
-
-    // 2004 has only four lines
-    if (is4line && (line > 3))
-        return;
-
-   // find separator
-    uint8_t* ptr = strchr(txt, ';');
-    uint8_t col = 0;
-    uint8_t maxcol = is4line ? 20 : 16;
-
-    // separator ?
-    if (ptr != NULL)
-    {
-        col = atoi(txt); // get column number
-        ptr++; // skip separator
-    }
-    else
-        ptr = txt;
-
-    // check column
-    if (col >= maxcol)
-        col = 0;
-
-    // set cursor
-    hd44780_cmd(i2c, addr, 0x80 | (col + row_offsets[line]));
-
-    uint8_t i;
-
-    // send string to lcd
-    for(i = col; (i < maxcol) && *ptr; i++, ptr++)
-        hd44780_data(i2c, addr, *ptr);
-}
-
-void dev_hd44780_bargraph(i2c_inst_t* i2c, uint8_t addr, uint8_t line, bool is4line, uint8_t data)
-{
-    // 1602 has only two lines
-    if (!is4line && (line > 1))
-        return;
-
-    // 2004 has only four lines
-    if (is4line && (line > 3))
-        return;
-
-    // clamp num
-    if (data > 100)
-        data = 100;
-
-    // set cursor to col 0
-    hd44780_cmd(i2c, addr, 0x80 | row_offsets[line]);
-
-    uint8_t maxcol = is4line ? 20 : 16;
-    uint8_t steps = is4line ? 5 : 6;
-    uint8_t i;
-
-    // print bargraph
-    for(i = 0; i < maxcol; i++)
-    {
-        if (data > (i*steps))
-            hd44780_data(i2c, addr, 0xFF);
-        else
-            hd44780_data(i2c, addr, ' ');
-    }
+// Copyright 2021 Ocean (iiot2k@gmail.com) 
+// All rights reserved.
+
+#include <stdlib.h>
+#include <string.h>
+
+//#include "sys_time.h"
+
+#include "dev_hd44780.h"
+
+#include "hardware/i2c.h"
+
+// FreeRTOS
+#include <FreeRTOS.h>
+#include <task.h>
+
+#define LCD_RW  0x2
+#define LCD_CS  0x4
+#define LCD_LED 0x8
+
+// one byte is sent as two nibbles, each strobed by a high and a low write
+#define HD44780_WRITES_PER_BYTE 4
+
+// the longest packed transaction: cursor plus a full line
+#define HD44780_PACKED_MAX ((1 + 20) * HD44780_WRITES_PER_BYTE)
+
+// a clear display (1.52 ms) is the slowest instruction
+#define HD44780_BUSY_TIMEOUT_US 3000
+
+static dev_hd44780_mode_t hd44780_mode = HD44780_MODE_PACKED;
+
+
+static inline int32_t sys_i2c_wbyte(i2c_inst_t* i2c, uint8_t addr, uint8_t wb)
+{
+    return i2c_write_timeout_us(i2c, addr, &wb, 1, false, 500);
+}
+
+
+// pack one byte into expander writes, the enable falls on the next write
+static inline uint8_t* hd44780_pack(uint8_t* buffer, uint8_t data, uint8_t rs)
+{
+    uint8_t data_h = (data & 0xF0) | LCD_LED | rs;
+    uint8_t data_l = (data << 4) | LCD_LED | rs;
+
+    *buffer++ = data_h | LCD_CS;
+    *buffer++ = data_h;
+    *buffer++ = data_l | LCD_CS;
+    *buffer++ = data_l;
+    return buffer;
+}
+
+// write to hd44780 module, waiting the worst case after each nibble
+static void hd44780_write_timed(i2c_inst_t* i2c, uint8_t addr, uint8_t data, uint8_t rs)
+{
+    uint8_t data_h = (data & 0xF0) | LCD_LED | rs;
+    uint8_t data_l = (data << 4) | LCD_LED | rs;
+
+    // write high byte and pulse CD with negative edge
+
+    //i2c_write_blocking(i2c, addr, data_h / LCD_CS, 1, false);
+    
+    sys_i2c_wbyte(i2c, addr, data_h | LCD_CS);
+    running_wait_us(100);
+    //vTaskDelay(1);
+    //sleep_us(100); // cs setup time
+    sys_i2c_wbyte(i2c, addr, data_h);
+    running_wait_us(200);
+    //vTaskDelay(1); 
+    //sleep_us(200); // data hold time
+
+    // write low byte and pulse CD with negative edge
+    sys_i2c_wbyte(i2c, addr, data_l | LCD_CS);
+    running_wait_us(100);
+    //vTaskDelay(1);
+    //sleep_us(100); // cs setup time
+    sys_i2c_wbyte(i2c, addr, data_l);
+    running_wait_us(200);
+    //vTaskDelay(1);
+    //sleep_us(200); // data hold time
+}
+
+// read the busy flag, the data lines are released (written high) and both
+// nibbles are strobed with R/W high, the low one is discarded.
+// Returns 1 if busy, 0 if ready, -1 if the module did not answer.
+static int hd44780_busy(i2c_inst_t* i2c, uint8_t addr)
+{
+    uint8_t idle = 0xF0 | LCD_LED | LCD_RW;
+    uint8_t status;
+
+    if (sys_i2c_wbyte(i2c, addr, idle | LCD_CS) < 0)
+        return -1;
+    if (i2c_read_timeout_us(i2c, addr, &status, 1, false, 500) < 0)
+        return -1;
+    sys_i2c_wbyte(i2c, addr, idle);
+    sys_i2c_wbyte(i2c, addr, idle | LCD_CS);
+    sys_i2c_wbyte(i2c, addr, idle);
+
+    return (status & 0x80) ? 1 : 0;
+}
+
+// poll until the controller is ready. Modules with R/W tied low read as
+// always busy, they are switched to timed mode once the timeout expires.
+static bool hd44780_wait_ready(i2c_inst_t* i2c, uint8_t addr)
+{
+    uint32_t start_us = time_us_32();
+
+    do
+    {
+        int busy = hd44780_busy(i2c, addr);
+        if (busy == 0)
+            return true;
+        if (busy < 0)
+            break;
+    } while (time_us_32() - start_us < HD44780_BUSY_TIMEOUT_US);
+
+    hd44780_mode = HD44780_MODE_TIMED;
+    return false;
+}
+
+// write to hd44780 module, then wait as the selected mode says
+static void hd44780_write(i2c_inst_t* i2c, uint8_t addr, uint8_t data, uint8_t rs)
+{
+    if (hd44780_mode != HD44780_MODE_BUSY)
+    {
+        hd44780_write_timed(i2c, addr, data, rs);
+        return;
+    }
+
+    // each expander write lasts long enough for the enable pulse
+    uint8_t buffer[HD44780_WRITES_PER_BYTE];
+    hd44780_pack(buffer, data, rs);
+    i2c_write_timeout_us(i2c, addr, buffer, sizeof(buffer), false, 1000);
+    hd44780_wait_ready(i2c, addr);
+}
+
+// set cursor and write characters, one transaction in packed mode.
+// At 400 kHz a write lasts 22.5 us, so the enable pulse is wide enough and
+// a character (4 writes) outlasts the 37 us the controller needs.
+static void hd44780_string(i2c_inst_t* i2c, uint8_t addr, uint8_t cursor, const uint8_t* data, uint8_t len)
+{
+    if (hd44780_mode != HD44780_MODE_PACKED)
+    {
+        hd44780_write(i2c, addr, cursor, 0);
+        for(uint8_t i = 0; i < len; i++)
+            hd44780_write(i2c, addr, data[i], 1);
+        return;
+    }
+
+    uint8_t buffer[HD44780_PACKED_MAX];
+    uint8_t* end = hd44780_pack(buffer, cursor, 0);
+
+    if (len > 20)
+        len = 20;
+    for(uint8_t i = 0; i < len; i++)
+        end = hd44780_pack(end, data[i], 1);
+
+    i2c_write_timeout_us(i2c, addr, buffer, end - buffer, false, 
+                         (end - buffer) * 100);
+}
+
+// write commend
+static void inline hd44780_cmd(i2c_inst_t* i2c, uint8_t addr, uint8_t data)
+{
+    hd44780_write(i2c, addr, data, 0);
+}
+
+// write data
+static void inline hd44780_data(i2c_inst_t* i2c, uint8_t addr, uint8_t data)
+{
+    hd44780_write(i2c, addr, data, 1);
+}
+
+void dev_hd44780_init(i2c_inst_t* i2c, uint8_t addr)
+{
+    // set interface to 4 bit
+    //sleep_ms(50);
+    //vTaskDelay(50);
+    // the busy flag can't be read before the interface is set
+    init_wait_ms(50);
+    hd44780_write_timed(i2c, addr, 0x03, 0);
+    hd44780_write_timed(i2c, addr, 0x03, 0);
+    hd44780_write_timed(i2c, addr, 0x03, 0);
+    hd44780_write_timed(i2c, addr, 0x02, 0);
+
+    // set lcd register
+    hd44780_cmd(i2c, addr, 0x04 | 0x02); // increment DDRAM
+    hd44780_cmd(i2c, addr, 0x08 | 0x04); // display on
+    hd44780_cmd(i2c, addr, 0x20 | 0x08); // 4bit, 2 lines, 5x8 dots
+
+    // clear display, busy mode has already waited for it
+    hd44780_cmd(i2c, addr, 0x01);
+    if (hd44780_mode != HD44780_MODE_BUSY)
+        init_wait_ms(20);
+    //vTaskDelay(20);
+    //sleep_ms(20);
+}
+
+static uint8_t row_offsets[] = { 0x00, 0x40, 0x14, 0x54 };
+
+void dev_hd44780_text(i2c_inst_t* i2c, uint8_t addr, uint8_t line, bool is4line, uint8_t* txt)
+{
+     // 1602 has only two lines
+    if (!is4line && (line > 1))
+        return;
+
+    // 2004 has only four lines
+    if (is4line && (line > 3))
+        return;
+
+   // find separator
+    uint8_t* ptr = strchr(txt, ';');
+    uint8_t col = 0;
+    uint8_t maxcol = is4line ? 20 : 16;
+
+    // separator ?
+    if (ptr != NULL)
+    {
+        col = atoi(txt); // get column number
+        ptr++; // skip separator
+    }
+    else
+        ptr = txt;
+
+    // check column
+    if (col >= maxcol)
+        col = 0;
+
+    // count characters that fit
+    uint8_t len = 0;
+    while ((col + len < maxcol) && ptr[len])
+        len++;
+
+    // set cursor and send string to lcd
+    hd44780_string(i2c, addr, 0x80 | (col + row_offsets[line]), ptr, len);
+}
+
+void dev_hd44780_write_at(i2c_inst_t* i2c, uint8_t addr, uint8_t line, bool is4line, uint8_t col, const uint8_t* data, uint8_t len)
+{
+    uint8_t maxcol = is4line ? 20 : 16;
+
+    if ((!is4line && (line > 1)) || (is4line && (line > 3)) || (col >= maxcol))
+        return;
+
+    // clip to the end of the line
+    if (col + len > maxcol)
+        len = maxcol - col;
+
+    // set cursor and send characters
+    hd44780_string(i2c, addr, 0x80 | (col + row_offsets[line]), data, len);
+}
+
+uint16_t dev_hd44780_pack_at(uint8_t* buffer, uint8_t line, bool is4line, uint8_t col, const uint8_t* data, uint8_t len)
+{
+    uint8_t maxcol = is4line ? 20 : 16;
+
+    if ((!is4line && (line > 1)) || (is4line && (line > 3)) || (col >= maxcol))
+        return 0;
+
+    // clip to the end of the line
+    if (col + len > maxcol)
+        len = maxcol - col;
+
+    // cursor then characters, as sent by the packed mode
+    uint8_t* end = hd44780_pack(buffer, 0x80 | (col + row_offsets[line]), 0);
+    for(uint8_t i = 0; i < len; i++)
+        end = hd44780_pack(end, data[i], 1);
+
+    return end - buffer;
+}
+
+void dev_hd44780_bargraph(i2c_inst_t* i2c, uint8_t addr, uint8_t line, bool is4line, uint8_t data)
+{
+    // 1602 has only two lines
+    if (!is4line && (line > 1))
+        return;
+
+    // 2004 has only four lines
+    if (is4line && (line > 3))
+        return;
+
+    // clamp num
+    if (data > 100)
+        data = 100;
+
+    uint8_t maxcol = is4line ? 20 : 16;
+    uint8_t steps = is4line ? 5 : 6;
+    uint8_t bar[20];
+    uint8_t i;
+
+    // print bargraph from col 0
+    for(i = 0; i < maxcol; i++)
+        bar[i] = (data > (i*steps)) ? 0xFF : ' ';
+
+    hd44780_string(i2c, addr, 0x80 | row_offsets[line], bar, maxcol);
+}
+
+void dev_hd44780_cgram(i2c_inst_t* i2c, uint8_t addr, uint8_t slot, const uint8_t* glyph)
+{
+    // set CGRAM address, the address counter then steps through the glyph
+    hd44780_cmd(i2c, addr, 0x40 | ((slot & 0x07) << 3));
+    for(uint8_t i = 0; i < 8; i++)
+        hd44780_data(i2c, addr, glyph[i] & 0x1F);
+
+    // back to DDRAM, at the home position
+    hd44780_cmd(i2c, addr, 0x80);
+}
+
+void dev_hd44780_set_mode(dev_hd44780_mode_t mode)
+{
+    hd44780_mode = mode;
+}
+
+dev_hd44780_mode_t dev_hd44780_get_mode(void)
+{
+    return hd44780_mode;
 }
\ No newline at end of file
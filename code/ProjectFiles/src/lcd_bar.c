@@ -0,0 +1,60 @@
+/**
+  ******************************************************************************
+  * @file    lcd_bar.c
+  * @author  Camilo Vera
+  * @brief   LCD bargraph
+  *          Bars drawn with partial block glyphs kept in the HD44780 CGRAM,
+  *          five steps per character cell. Bars are plain characters of a
+  *          row, so the shadow framebuffer only sends the cells that change.
+  ******************************************************************************
+*/
+
+#include "lcd_bar.h"
+
+/* Includes ------------------------------------------------------------------*/
+
+// Standard C libraries
+#include <stdint.h>
+#include <stdbool.h>
+
+// Project libraries
+#include "lcd_frame.h"
+
+const uint8_t lcd_bar_glyphs[LCD_BAR_GLYPHS][LCD_BAR_GLYPH_ROWS] = {
+    {0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10},
+    {0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18},
+    {0x1C, 0x1C, 0x1C, 0x1C, 0x1C, 0x1C, 0x1C, 0x1C},
+    {0x1E, 0x1E, 0x1E, 0x1E, 0x1E, 0x1E, 0x1E, 0x1E}
+};
+
+void Lcd_bar_render(char* row, uint8_t col, uint8_t width, int32_t value,
+                    int32_t full){
+    if(full <= 0){
+        full = 1;
+        value = 0;
+    }
+    if(value < 0){
+        value = 0;
+    }else if(value > full){
+        value = full;
+    }
+    if(col + width > LCD_COLS){
+        width = col < LCD_COLS ? LCD_COLS - col : 0;
+    }
+
+    // Lit pixel columns, rounded to the nearest
+    uint32_t steps = ((uint32_t)value * width * LCD_BAR_CELL_STEPS
+                      + (uint32_t)full / 2) / (uint32_t)full;
+
+    for(uint8_t cell = 0; cell < width; cell++){
+        if(steps >= LCD_BAR_CELL_STEPS){
+            row[col + cell] = (char)LCD_BAR_FULL;
+            steps -= LCD_BAR_CELL_STEPS;
+        }else if(steps > 0){
+            row[col + cell] = (char)(LCD_BAR_FIRST_GLYPH + steps - 1);
+            steps = 0;
+        }else{
+            row[col + cell] = ' ';
+        }
+    }
+}
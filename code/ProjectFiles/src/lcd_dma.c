@@ -0,0 +1,150 @@
+/**
+  ******************************************************************************
+  * @file    lcd_dma.c
+  * @author  Camilo Vera
+  * @brief   LCD DMA transport
+  *          Sends a packed HD44780/PCF8574 byte stream as one I2C write fed
+  *          by DMA. The I2C stop interrupt reports the end of the transfer,
+  *          so the CPU is free while the display is written.
+  ******************************************************************************
+*/
+
+#include "lcd_dma.h"
+
+/* Includes ------------------------------------------------------------------*/
+
+// Standard C libraries
+#include <stdint.h>
+#include <stdbool.h>
+
+// SDK Libraries
+#include "pico/stdlib.h"
+#include "hardware/i2c.h"
+#include "hardware/dma.h"
+#include "hardware/irq.h"
+
+// Transport served by the I2C interrupt
+static Lcd_Dma* irq_lcd = NULL;
+
+static uint lcd_irq(Lcd_Dma const* this){
+    return i2c_hw_index(this->i2c) == 0 ? I2C0_IRQ : I2C1_IRQ;
+}
+
+static void lcd_dma_irq_handler(void){
+    Lcd_Dma* this = irq_lcd;
+    i2c_hw_t* hw = i2c_get_hw(this->i2c);
+    uint32_t status = hw->raw_intr_stat;
+    bool ok = !(status & I2C_IC_RAW_INTR_STAT_TX_ABRT_BITS);
+
+    // The stop also follows an abort, both end the transfer
+    if(!(status & I2C_IC_RAW_INTR_STAT_STOP_DET_BITS)){
+        return;
+    }
+    hw->intr_mask = 0;
+    (void)hw->clr_stop_det;
+    if(!ok){
+        dma_channel_abort(this->dma);
+        (void)hw->clr_tx_abrt;
+        this->aborts++;
+    }
+
+    this->last_us = time_us_32() - this->start_us;
+    if(this->last_us > this->max_us){
+        this->max_us = this->last_us;
+    }
+    this->busy = false;
+
+    if(this->callback != NULL){
+        this->callback(this->context, ok);
+    }
+}
+
+void Lcd_dma_init(Lcd_Dma* this, i2c_inst_t* i2c, uint8_t addr,
+                  Lcd_Dma_Callback callback, void* context){
+    i2c_hw_t* hw = i2c_get_hw(i2c);
+
+    this->i2c = i2c;
+    this->addr = addr;
+    this->busy = false;
+    this->start_us = 0;
+    this->callback = callback;
+    this->context = context;
+    this->transfers = 0;
+    this->aborts = 0;
+    this->last_us = 0;
+    this->max_us = 0;
+
+    // Words are pushed to DATA_CMD as the TX FIFO drains
+    this->dma = dma_claim_unused_channel(true);
+    dma_channel_config config = dma_channel_get_default_config(this->dma);
+    channel_config_set_transfer_data_size(&config, DMA_SIZE_16);
+    channel_config_set_read_increment(&config, true);
+    channel_config_set_write_increment(&config, false);
+    channel_config_set_dreq(&config, i2c_get_dreq(i2c, true));
+    dma_channel_configure(this->dma, &config, &hw->data_cmd, this->cmds, 0,
+                          false);
+
+    // Unmasked only while a transfer runs
+    hw->intr_mask = 0;
+    irq_lcd = this;
+    irq_set_exclusive_handler(lcd_irq(this), lcd_dma_irq_handler);
+    irq_set_enabled(lcd_irq(this), true);
+}
+
+bool Lcd_dma_ready(Lcd_Dma* this){
+    if(this->busy){
+        if(time_us_32() - this->start_us <= LCD_DMA_TIMEOUT_US){
+            return false;
+        }
+        Lcd_dma_abort(this);        // Stop interrupt never came
+    }
+    return true;
+}
+
+bool Lcd_dma_send(Lcd_Dma* this, uint8_t const* data, uint16_t len){
+    i2c_hw_t* hw = i2c_get_hw(this->i2c);
+
+    if(!Lcd_dma_ready(this)){
+        return false;
+    }
+    if(len == 0){
+        return true;
+    }
+    if(len > LCD_DMA_MAX_BYTES){
+        len = LCD_DMA_MAX_BYTES;
+    }
+
+    for(uint16_t i = 0; i < len; i++){
+        this->cmds[i] = data[i];
+    }
+    this->cmds[len - 1] |= I2C_IC_DATA_CMD_STOP_BITS;
+
+    hw->enable = 0;
+    hw->tar = this->addr;
+    hw->enable = 1;
+
+    (void)hw->clr_stop_det;
+    (void)hw->clr_tx_abrt;
+    hw->intr_mask = I2C_IC_INTR_MASK_M_STOP_DET_BITS
+                    | I2C_IC_INTR_MASK_M_TX_ABRT_BITS;
+
+    this->start_us = time_us_32();
+    this->busy = true;
+    this->transfers++;
+    dma_channel_transfer_from_buffer_now(this->dma, this->cmds, len);
+    return true;
+}
+
+void Lcd_dma_abort(Lcd_Dma* this){
+    i2c_hw_t* hw = i2c_get_hw(this->i2c);
+
+    hw->intr_mask = 0;
+    dma_channel_abort(this->dma);
+
+    // Reading the registers clears the abort and flushes the FIFO
+    (void)hw->clr_tx_abrt;
+    (void)hw->clr_stop_det;
+
+    this->aborts++;
+    this->busy = false;
+}
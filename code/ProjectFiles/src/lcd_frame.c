@@ -0,0 +1,105 @@
+/**
+  ******************************************************************************
+  * @file    lcd_frame.c
+  * @author  Camilo Vera
+  * @brief   LCD shadow framebuffer
+  *          Keeps a copy of what the display shows and sends only the cells
+  *          that change, as runs of characters behind one cursor move.
+  ******************************************************************************
+*/
+
+#include "lcd_frame.h"
+
+/* Includes ------------------------------------------------------------------*/
+
+// Standard C libraries
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+void Lcd_frame_init(Lcd_Frame* frame){
+    memset(frame->glass, ' ', sizeof(frame->glass));
+    memset(frame->next, ' ', sizeof(frame->next));
+    memset(frame->dirty, 0, sizeof(frame->dirty));
+    frame->flushes = 0;
+    frame->bytes_sent = 0;
+    frame->bytes_saved = 0;
+}
+
+void Lcd_frame_set_row(Lcd_Frame* frame, uint8_t row, char const* text){
+    if(row >= LCD_ROWS){
+        return;
+    }
+    for(uint8_t col = 0; col < LCD_COLS && text[col] != '\0'; col++){
+        frame->next[row][col] = (uint8_t)text[col];
+    }
+    frame->dirty[row] = true;
+}
+
+bool Lcd_frame_pending(Lcd_Frame const* frame){
+    for(uint8_t row = 0; row < LCD_ROWS; row++){
+        if(frame->dirty[row]){
+            return true;
+        }
+    }
+    return false;
+}
+
+void Lcd_frame_invalidate(Lcd_Frame* frame){
+    for(uint8_t row = 0; row < LCD_ROWS; row++){
+        for(uint8_t col = 0; col < LCD_COLS; col++){
+            frame->glass[row][col] = ~frame->next[row][col];
+        }
+        frame->dirty[row] = true;
+    }
+}
+
+// Runs of changed cells, close runs are merged
+static uint32_t flush_row(Lcd_Frame* frame, uint8_t row,
+                          Lcd_Frame_Writer writer, void* context){
+    uint8_t const* next = frame->next[row];
+    uint8_t* glass = frame->glass[row];
+    uint32_t sent = 0;
+    uint8_t col = 0;
+
+    while(col < LCD_COLS){
+        if(next[col] == glass[col]){
+            col++;
+            continue;
+        }
+        uint8_t start = col;
+        uint8_t end = col + 1;          // One past the last changed cell
+        for(uint8_t scan = end; scan < LCD_COLS; scan++){
+            if(next[scan] != glass[scan]){
+                if(scan - end > LCD_FRAME_MERGE_GAP){
+                    break;
+                }
+                end = scan + 1;
+            }
+        }
+        writer(context, row, start, &next[start], end - start);
+        memcpy(&glass[start], &next[start], end - start);
+        sent += 1 + (end - start);
+        col = end;
+    }
+    return sent;
+}
+
+uint32_t Lcd_frame_flush(Lcd_Frame* frame, Lcd_Frame_Writer writer,
+                         void* context){
+    uint32_t sent = 0;
+    uint32_t full = 0;
+
+    for(uint8_t row = 0; row < LCD_ROWS; row++){
+        if(!frame->dirty[row]){
+            continue;
+        }
+        frame->dirty[row] = false;
+        sent += flush_row(frame, row, writer, context);
+        full += 1 + LCD_COLS;
+    }
+    frame->flushes++;
+    frame->bytes_sent += sent;
+    frame->bytes_saved += full - sent;
+    return sent;
+}
@@ -45,6 +45,7 @@
 
 // Project libraries
 #include "bsp.h"
+#include "ui_script.h"
 
 
 // Task Data
@@ -115,6 +116,16 @@ int main(){
                  0U);
 
 
+#if UI_SCRIPT_RUNNER
+    // The AO tasks never run, the UI is driven by the script
+    UI_Script_Result result;
+    UI_script_run(&ui, &printer, ui_script_default, &result);
+    UI_script_report(&result);
+    while(true){
+        tight_loop_contents();
+    }
+#endif
+
     //BSP_start(); /* configure and start interrupts */
     vTaskStartScheduler(); /* start the FreeRTOS scheduler... */
     return 0; /* NOTE: the scheduler does NOT return */
@@ -0,0 +1,181 @@
+/** 
+  ******************************************************************************
+  * @file    motion_plan.c
+  * @author  Camilo Vera
+  * @brief   Routine motion plan
+  *          Compiles a whole exercise routine into a flat list of timed 
+  *          motion steps, executed autonomously by the Motors AO.
+  ****************************************************************************** 
+*/
+
+#include "motion_plan.h"
+
+/* Includes ------------------------------------------------------------------*/
+
+// Standard C libraries
+#include <stdint.h>
+#include <stdbool.h>
+
+// Valid targets of every axis of AXIS_LIST, deg10
+static const int16_t axis_min[AXIS_COUNT] = {
+#define AXIS_MIN(n) MOTOR##n##_DEG10_MIN,
+    AXIS_LIST(AXIS_MIN)
+#undef AXIS_MIN
+};
+static const int16_t axis_max[AXIS_COUNT] = {
+#define AXIS_MAX(n) MOTOR##n##_DEG10_MAX,
+    AXIS_LIST(AXIS_MAX)
+#undef AXIS_MAX
+};
+
+static bool plan_add(Motion_Plan* plan, Motion_Plan_Op op, 
+                     Motion_Plan_Phase phase, Axis_Id axis, uint8_t exercise,
+                     uint16_t speed, int32_t value){
+    if(plan->num_steps >= MOTION_PLAN_MAX_STEPS){
+        return false;
+    }
+    plan->steps[plan->num_steps++] = (Motion_Plan_Step){
+        .op = op, .phase = phase, .axis = axis, .exercise = exercise, 
+        .speed = speed, .value = value
+    };
+    return true;
+}
+
+static bool plan_add_path(Motion_Plan* plan, Motion_Plan_Op op, 
+                          Motion_Plan_Phase phase, uint8_t exercise,
+                          uint16_t speed, int32_t value, int16_t aux){
+    if(!plan_add(plan, op, phase, AXIS_M1, exercise, speed, value)){
+        return false;
+    }
+    plan->steps[plan->num_steps - 1].aux = aux;
+    return true;
+}
+
+// Repetitions of the M1 and M2 coordinated exercises, the same range is
+// used on both axes
+static bool plan_add_coordinated(Motion_Plan* plan, Exercise const* exercise,
+                                 uint8_t n){
+    int32_t hold_ms = (int32_t)exercise->time_pos*1000;
+    int16_t center = (exercise->lim_min + exercise->lim_max)/2;
+    int16_t radius = (exercise->lim_max - exercise->lim_min)/2;
+    bool fits = true;
+
+    if(exercise->type_of_exercise == MOTION_PLAN_CIRCUMDUCTION){
+        // Back to the start point in every repetition, so a repetition
+        // restarted after a pause never jumps
+        fits &= plan_add(plan, MOTION_PLAN_REP_START, MOTION_PLAN_TO_START,
+                         AXIS_M1, n, 0, 0);
+        fits &= plan_add_path(plan, MOTION_PLAN_LINE, MOTION_PLAN_TO_START, n,
+                              exercise->speed, center + radius, center);
+        fits &= plan_add_path(plan, MOTION_PLAN_CIRCLE, MOTION_PLAN_CIRCLE_PATH,
+                              n, exercise->speed, radius, center);
+        fits &= plan_add(plan, MOTION_PLAN_HOLD, MOTION_PLAN_HOLD_MAX,
+                         AXIS_M1, n, 0, hold_ms);
+    }else{
+        fits &= plan_add(plan, MOTION_PLAN_REP_START, MOTION_PLAN_TO_MIN,
+                         AXIS_M1, n, 0, 0);
+        fits &= plan_add_path(plan, MOTION_PLAN_LINE, MOTION_PLAN_TO_MIN, n,
+                              exercise->speed, exercise->lim_min, 
+                              exercise->lim_min);
+        fits &= plan_add(plan, MOTION_PLAN_HOLD, MOTION_PLAN_HOLD_MIN,
+                         AXIS_M1, n, 0, hold_ms);
+        fits &= plan_add_path(plan, MOTION_PLAN_LINE, MOTION_PLAN_TO_MAX, n,
+                              exercise->speed, exercise->lim_max, 
+                              exercise->lim_max);
+        fits &= plan_add(plan, MOTION_PLAN_HOLD, MOTION_PLAN_HOLD_MAX,
+                         AXIS_M1, n, 0, hold_ms);
+    }
+    fits &= plan_add(plan, MOTION_PLAN_REPEAT, MOTION_PLAN_HOLD_MAX,
+                     AXIS_M1, n, 0, exercise->num_of_reps);
+    return fits;
+}
+
+static bool exercise_coordinated(Exercise const* exercise){
+    return exercise->type_of_exercise == MOTION_PLAN_CIRCUMDUCTION ||
+           exercise->type_of_exercise == MOTION_PLAN_DIAGONAL;
+}
+
+// Type 0 (PronoSupination) moves M2, the others M1 with the bar in place
+static Axis_Id exercise_axis(Exercise const* exercise){
+    return exercise->type_of_exercise == 0 ? AXIS_M2 : AXIS_M1;
+}
+
+static int32_t exercise_bar(Exercise const* exercise){
+    return exercise->type_of_exercise == 2 ? MOTION_PLAN_BAR_HORIZONTAL : 
+                                             MOTION_PLAN_BAR_VERTICAL;
+}
+
+bool Motion_plan_compile(Motion_Plan* plan, Routine const* routine){
+    bool fits = true;
+
+    plan->num_steps = 0;
+    for(uint8_t n = 0; n < routine->num_ejercicios; n++){
+        Exercise const* exercise = &routine->ejercicios[n];
+        Axis_Id axis = exercise_axis(exercise);
+        int32_t hold_ms = (int32_t)exercise->time_pos*1000;
+
+        if(n > 0){
+            fits &= plan_add(plan, MOTION_PLAN_MOVE, MOTION_PLAN_CENTER, 
+                             AXIS_M1, n, 0, 0);
+            fits &= plan_add(plan, MOTION_PLAN_HOLD, MOTION_PLAN_PAUSE, 
+                             AXIS_M1, n, 0, (int32_t)routine->pause*1000);
+        }
+        fits &= plan_add(plan, MOTION_PLAN_MOVE, MOTION_PLAN_POSITION_BAR,
+                         AXIS_M2, n, 0, exercise_bar(exercise));
+        fits &= plan_add(plan, MOTION_PLAN_HOLD, MOTION_PLAN_POSITION_BAR,
+                         AXIS_M2, n, 0, MOTION_PLAN_BAR_SETTLE_MS);
+
+        if(exercise_coordinated(exercise)){
+            fits &= plan_add_coordinated(plan, exercise, n);
+            continue;
+        }
+        fits &= plan_add(plan, MOTION_PLAN_REP_START, MOTION_PLAN_TO_MIN,
+                         axis, n, 0, 0);
+        fits &= plan_add(plan, MOTION_PLAN_MOVE, MOTION_PLAN_TO_MIN,
+                         axis, n, exercise->speed, exercise->lim_min);
+        fits &= plan_add(plan, MOTION_PLAN_HOLD, MOTION_PLAN_HOLD_MIN,
+                         axis, n, 0, hold_ms);
+        fits &= plan_add(plan, MOTION_PLAN_MOVE, MOTION_PLAN_TO_MAX,
+                         axis, n, exercise->speed, exercise->lim_max);
+        fits &= plan_add(plan, MOTION_PLAN_HOLD, MOTION_PLAN_HOLD_MAX,
+                         axis, n, 0, hold_ms);
+        fits &= plan_add(plan, MOTION_PLAN_REPEAT, MOTION_PLAN_HOLD_MAX,
+                         axis, n, 0, exercise->num_of_reps);
+    }
+
+    if(routine->num_ejercicios > 0){
+        Exercise const* last = &routine->ejercicios[routine->num_ejercicios - 1];
+        uint8_t n = routine->num_ejercicios - 1;
+
+        fits &= plan_add(plan, MOTION_PLAN_HOLD, MOTION_PLAN_END, 
+                         AXIS_M1, n, 0, MOTION_PLAN_END_DELAY_MS);
+        fits &= plan_add(plan, MOTION_PLAN_MOVE, MOTION_PLAN_END, 
+                         AXIS_M1, n, 0, 0);
+        fits &= plan_add(plan, MOTION_PLAN_MOVE, MOTION_PLAN_END, 
+                         AXIS_M2, n, 0, exercise_bar(last));
+    }
+    return fits;
+}
+
+bool Motion_plan_waypoints(Motion_Plan* plan, Motion_Waypoint const* waypoints,
+                           uint8_t count){
+    bool fits = true;
+
+    plan->num_steps = 0;
+    for(uint8_t n = 0; n < count; n++){
+        Motion_Waypoint const* waypoint = &waypoints[n];
+
+        if(waypoint->axis >= AXIS_COUNT ||
+           waypoint->target < axis_min[waypoint->axis] ||
+           waypoint->target > axis_max[waypoint->axis]){
+            return false;
+        }
+        fits &= plan_add(plan, MOTION_PLAN_MOVE, MOTION_PLAN_WAYPOINT, 
+                         waypoint->axis, n, waypoint->speed, waypoint->target);
+        if(waypoint->dwell_ms > 0){
+            fits &= plan_add(plan, MOTION_PLAN_HOLD, MOTION_PLAN_DWELL,
+                             waypoint->axis, n, 0, waypoint->dwell_ms);
+        }
+    }
+    return fits;
+}
@@ -0,0 +1,130 @@
+/** 
+  ******************************************************************************
+  * @file    motion_profile.c
+  * @author  Camilo Vera
+  * @brief   Smooth motion profiles
+  *          Samples a normalized trajectory shape at a fixed control period
+  *          into step chunks and step rates, integer arithmetic only.
+  ****************************************************************************** 
+*/
+
+#include "motion_profile.h"
+
+/* Includes ------------------------------------------------------------------*/
+
+// Standard C libraries
+#include <stdint.h>
+#include <stdbool.h>
+
+// Project libraries
+#include "fixed_point.h"
+#include "motion_tables.h"
+
+static uint32_t shape_peak_vel(Motion_Shape shape){
+    return shape == MOTION_SHAPE_MIN_JERK ? MOTION_SHAPE_MIN_JERK_PEAK_VEL : 
+                                            MOTION_SHAPE_SINE_PEAK_VEL;
+}
+
+// Rounded up to whole control periods, at least one
+static uint32_t control_periods(uint32_t duration_ms){
+    uint32_t periods = (duration_ms + MOTION_CONTROL_PERIOD_MS - 1) 
+                       / MOTION_CONTROL_PERIOD_MS;
+    return (periods > 0 ? periods : 1)*MOTION_CONTROL_PERIOD_MS;
+}
+
+// Longest of the axis durations, peak_distance steps covered at unit speed
+static uint32_t path_duration(int32_t const peak_distance[AXIS_COUNT],
+                              uint32_t const max_freq[AXIS_COUNT],
+                              uint64_t scale){
+    uint32_t duration_ms = 0;
+
+    for(int axis = 0; axis < AXIS_COUNT; axis++){
+        uint64_t distance = peak_distance[axis] < 0 ? -peak_distance[axis] :
+                                                      peak_distance[axis];
+        uint32_t axis_ms = (uint32_t)((scale*distance + max_freq[axis] - 1) 
+                                      / max_freq[axis]);
+        if(axis_ms > duration_ms){
+            duration_ms = axis_ms;
+        }
+    }
+    return control_periods(duration_ms);
+}
+
+void Motion_profile_init(Motion_Profile* profile, Motion_Shape shape,
+                         uint32_t distance, uint32_t max_freq){
+    uint32_t peak_vel = shape_peak_vel(shape);
+    // T = peak * D / Vmax, peak is in thousandths so T comes out in ms
+    uint32_t duration_ms = (peak_vel*distance + max_freq - 1) / max_freq;
+
+    profile->shape = shape;
+    profile->distance = distance;
+    profile->duration_ms = control_periods(duration_ms);
+    profile->elapsed_ms = 0;
+    profile->sent = 0;
+}
+
+bool Motion_profile_next(Motion_Profile* profile, uint16_t* steps){
+    profile->elapsed_ms += MOTION_CONTROL_PERIOD_MS;
+
+    q16_t t = q16_from_ratio(profile->elapsed_ms, profile->duration_ms);
+    uint32_t target = q16_to_int(profile->distance
+                                 *motion_shape(profile->shape, t));
+
+    *steps = target > profile->sent ? target - profile->sent : 0;
+    profile->sent += *steps;
+
+    return profile->elapsed_ms >= profile->duration_ms;
+}
+
+uint32_t Motion_profile_freq(uint16_t steps){
+    return (steps*1000U*100U + MOTION_CONTROL_PERIOD_MS*MOTION_CHUNK_FILL - 1)
+           / (MOTION_CONTROL_PERIOD_MS*MOTION_CHUNK_FILL);
+}
+
+void Motion_path_line(Motion_Path* path, Motion_Shape shape,
+                      int32_t const start[AXIS_COUNT],
+                      int32_t const end[AXIS_COUNT],
+                      uint32_t const max_freq[AXIS_COUNT]){
+    path->kind = MOTION_PATH_LINE;
+    path->shape = shape;
+    for(int axis = 0; axis < AXIS_COUNT; axis++){
+        path->origin[axis] = start[axis];
+        path->extent[axis] = end[axis] - start[axis];
+    }
+    path->duration_ms = path_duration(path->extent, max_freq, 
+                                      shape_peak_vel(shape));
+    path->elapsed_ms = 0;
+}
+
+void Motion_path_circle(Motion_Path* path, Motion_Shape shape,
+                        int32_t const center[AXIS_COUNT],
+                        int32_t const radius[AXIS_COUNT],
+                        uint32_t const max_freq[AXIS_COUNT]){
+    path->kind = MOTION_PATH_CIRCLE;
+    path->shape = shape;
+    for(int axis = 0; axis < AXIS_COUNT; axis++){
+        path->origin[axis] = center[axis];
+        path->extent[axis] = radius[axis];
+    }
+    // The angle follows the shape, an axis peaks at 2 pi radius times it
+    path->duration_ms = path_duration(path->extent, max_freq,
+                                      (uint64_t)shape_peak_vel(shape)
+                                      *MOTION_TWO_PI/1000);
+    path->elapsed_ms = 0;
+}
+
+bool Motion_path_next(Motion_Path* path, int32_t position[AXIS_COUNT]){
+    path->elapsed_ms += MOTION_CONTROL_PERIOD_MS;
+
+    q16_t t = q16_from_ratio(path->elapsed_ms, path->duration_ms);
+    q16_t s = motion_shape(path->shape, t);
+
+    for(int axis = 0; axis < AXIS_COUNT; axis++){
+        q16_t factor = path->kind == MOTION_PATH_LINE ? s :
+                       motion_cos(s - axis*(Q16_ONE/4));
+        position[axis] = path->origin[axis] 
+                         + q16_to_int(q16_mul(q16_from_int(path->extent[axis]),
+                                              factor));
+    }
+    return path->elapsed_ms >= path->duration_ms;
+}
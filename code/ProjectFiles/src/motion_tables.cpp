@@ -0,0 +1,301 @@
+/** 
+  ******************************************************************************
+  * @file    motion_tables.cpp
+  * @author  Camilo Vera
+  * @brief   Motion lookup tables
+  *          Unit conversions and normalized trajectory shapes, generated at 
+  *          compile time and stored in flash.
+  ****************************************************************************** 
+*/
+
+#include "motion_tables.h"
+
+/* Includes ------------------------------------------------------------------*/
+
+// Standard C++ libraries
+#include <array>
+#include <cstdint>
+#include <numeric>
+
+// Project libraries
+#include "axis_config.h"
+#include "fixed_point.h"
+
+namespace {
+
+// Table generation only, a 64 bit division is a library call on the M0+
+constexpr int32_t floor_div(int64_t num, int64_t den){
+    int64_t quotient = num / den;
+    if((num % den != 0) && ((num < 0) != (den < 0))){
+        quotient--;
+    }
+    return static_cast<int32_t>(quotient);
+}
+
+// Runtime lookups, den is a small positive constant
+constexpr int32_t floor_div(int32_t num, int32_t den){
+    int32_t quotient = num / den;
+    if(num % den < 0){
+        quotient--;
+    }
+    return quotient;
+}
+
+/* Conversions ---------------------------------------------------------------*/
+
+/**
+ * round(x * Num / Den) repeats every Den/gcd inputs with an increment of 
+ * Num/gcd, so only one period of residues is stored.
+ */
+template <int32_t Num, int32_t Den>
+class RationalTable{
+public:
+    static constexpr int32_t period = Den / std::gcd(Num, Den);
+    static constexpr int32_t increment = Num / std::gcd(Num, Den);
+
+    static constexpr int32_t reference(int32_t x){
+        return floor_div(static_cast<int64_t>(x) * Num + Den/2, 
+                         static_cast<int64_t>(Den));
+    }
+
+    constexpr RationalTable() : residue{}{
+        for(int32_t r = 0; r < period; r++){
+            residue[r] = static_cast<int16_t>(reference(r));
+        }
+    }
+
+    constexpr int32_t operator()(int32_t x) const{
+        int32_t quotient = floor_div(x, period);
+        return quotient*increment + residue[x - quotient*period];
+    }
+
+    // Compares every input in [from, to] against the exact formula
+    constexpr bool check(int32_t from, int32_t to) const{
+        for(int32_t x = from; x <= to; x++){
+            if((*this)(x) != reference(x)){
+                return false;
+            }
+        }
+        return true;
+    }
+
+private:
+    std::array<int16_t, period> residue;
+};
+
+template <int32_t StepsPerRev, int32_t Transmission>
+struct AxisTables{
+    static constexpr RationalTable<StepsPerRev*Transmission, FP_DEG10_PER_REV> 
+        deg10_to_steps{};
+    static constexpr RationalTable<FP_DEG10_PER_REV, StepsPerRev*Transmission> 
+        steps_to_deg10{};
+    static constexpr RationalTable<FP_DEG10_PER_REV, FP_COUNTS_PER_REV*Transmission> 
+        counts_to_deg10{};
+
+    static_assert(deg10_to_steps.check(-4*FP_DEG10_PER_REV, 4*FP_DEG10_PER_REV),
+                  "deg10 to steps table");
+    static_assert(steps_to_deg10.check(-4*StepsPerRev*Transmission, 
+                                       4*StepsPerRev*Transmission),
+                  "steps to deg10 table");
+    static_assert(counts_to_deg10.check(-4*FP_COUNTS_PER_REV*Transmission,
+                                        4*FP_COUNTS_PER_REV*Transmission),
+                  "counts to deg10 table");
+};
+
+template <typename Tables>
+int32_t deg10_to_steps(int32_t deg10){ return Tables::deg10_to_steps(deg10); }
+
+template <typename Tables>
+int32_t steps_to_deg10(int32_t steps){ return Tables::steps_to_deg10(steps); }
+
+template <typename Tables>
+int32_t counts_to_deg10(int32_t counts){ return Tables::counts_to_deg10(counts); }
+
+using Conversion = int32_t (*)(int32_t);
+
+// One instantiation per axis of AXIS_LIST, indexed by Axis_Id
+#define AXIS_TABLES(n) AxisTables<MOTOR##n##_STEPS_PER_REV, MOTOR##n##_TRANSMISSION_RATE>
+#define AXIS_DEG10_TO_STEPS(n) &deg10_to_steps<AXIS_TABLES(n)>,
+#define AXIS_STEPS_TO_DEG10(n) &steps_to_deg10<AXIS_TABLES(n)>,
+#define AXIS_COUNTS_TO_DEG10(n) &counts_to_deg10<AXIS_TABLES(n)>,
+
+constexpr Conversion deg10_to_steps_table[AXIS_COUNT] = {
+    AXIS_LIST(AXIS_DEG10_TO_STEPS)
+};
+constexpr Conversion steps_to_deg10_table[AXIS_COUNT] = {
+    AXIS_LIST(AXIS_STEPS_TO_DEG10)
+};
+constexpr Conversion counts_to_deg10_table[AXIS_COUNT] = {
+    AXIS_LIST(AXIS_COUNTS_TO_DEG10)
+};
+
+/* Shapes --------------------------------------------------------------------*/
+
+using ShapeTable = std::array<q16_t, MOTION_SHAPE_SAMPLES + 1>;
+
+constexpr double pi = 3.14159265358979323846;
+
+// std::cos is not constexpr, Taylor series is exact enough on [0, pi]
+constexpr double cos_taylor(double x){
+    double term = 1.0;
+    double sum = 1.0;
+    for(int n = 1; n < 20; n++){
+        term *= -x*x / ((2*n - 1)*(2*n));
+        sum += term;
+    }
+    return sum;
+}
+
+constexpr q16_t to_q16(double value){
+    return static_cast<q16_t>(value*Q16_ONE + (value >= 0 ? 0.5 : -0.5));
+}
+
+constexpr double min_jerk(double t){
+    return t*t*t*(10.0 + t*(-15.0 + 6.0*t));
+}
+
+constexpr double sine(double t){
+    return (1.0 - cos_taylor(pi*t)) / 2.0;
+}
+
+template <typename Shape>
+constexpr ShapeTable make_shape(Shape shape){
+    ShapeTable table{};
+    for(int i = 0; i <= MOTION_SHAPE_SAMPLES; i++){
+        table[i] = to_q16(shape(static_cast<double>(i) / MOTION_SHAPE_SAMPLES));
+    }
+    return table;
+}
+
+// Rest to rest: exact ends, monotonic and point symmetric around the middle
+constexpr bool check_shape(ShapeTable const& table){
+    if(table[0] != 0 || table[MOTION_SHAPE_SAMPLES] != Q16_ONE){
+        return false;
+    }
+    for(int i = 0; i <= MOTION_SHAPE_SAMPLES; i++){
+        if(i > 0 && table[i] < table[i - 1]){
+            return false;
+        }
+        int32_t asymmetry = table[i] + table[MOTION_SHAPE_SAMPLES - i] - Q16_ONE;
+        if(asymmetry > 1 || asymmetry < -1){
+            return false;
+        }
+    }
+    return true;
+}
+
+// Finite differences of the samples must respect the advertised peaks, the
+// profile generator sizes move durations with them. Two LSB of rounding.
+constexpr bool check_peaks(ShapeTable const& table, int32_t peak_vel,
+                           int32_t peak_acc){
+    constexpr double lsb = 2.0 / Q16_ONE;
+    constexpr double dt = 1.0 / MOTION_SHAPE_SAMPLES;
+
+    for(int i = 1; i <= MOTION_SHAPE_SAMPLES; i++){
+        double velocity = (table[i] - table[i - 1]) / (double)Q16_ONE / dt;
+        if(velocity > peak_vel / 1000.0 + lsb / dt){
+            return false;
+        }
+        if(i < MOTION_SHAPE_SAMPLES){
+            double acceleration = (table[i + 1] - 2*table[i] + table[i - 1]) 
+                                  / (double)Q16_ONE / (dt*dt);
+            double bound = peak_acc / 1000.0 + 2*lsb / (dt*dt);
+            if(acceleration > bound || acceleration < -bound){
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+constexpr ShapeTable min_jerk_table = make_shape(min_jerk);
+constexpr ShapeTable sine_table = make_shape(sine);
+
+static_assert(check_shape(min_jerk_table), "min jerk shape table");
+static_assert(check_shape(sine_table), "sine shape table");
+static_assert(check_peaks(min_jerk_table, MOTION_SHAPE_MIN_JERK_PEAK_VEL,
+                          MOTION_SHAPE_MIN_JERK_PEAK_ACC), "min jerk peaks");
+static_assert(check_peaks(sine_table, MOTION_SHAPE_SINE_PEAK_VEL,
+                          MOTION_SHAPE_SINE_PEAK_ACC), "sine peaks");
+
+/* Cosine --------------------------------------------------------------------*/
+
+using CosTable = std::array<q16_t, MOTION_COS_SAMPLES + 1>;
+
+constexpr CosTable make_cos(){
+    CosTable table{};
+    for(int i = 0; i <= MOTION_COS_SAMPLES; i++){
+        table[i] = to_q16(cos_taylor(pi/2 * i / MOTION_COS_SAMPLES));
+    }
+    return table;
+}
+
+// First quarter: exact ends and decreasing
+constexpr bool check_cos(CosTable const& table){
+    if(table[0] != Q16_ONE || table[MOTION_COS_SAMPLES] != 0){
+        return false;
+    }
+    for(int i = 1; i <= MOTION_COS_SAMPLES; i++){
+        if(table[i] >= table[i - 1]){
+            return false;
+        }
+    }
+    return true;
+}
+
+constexpr CosTable cos_table = make_cos();
+
+static_assert(check_cos(cos_table), "cosine table");
+
+} // namespace
+
+/* Functions -----------------------------------------------------------------*/
+
+int32_t motion_deg10_to_steps(Axis_Id axis, int32_t deg10){
+    return deg10_to_steps_table[axis](deg10);
+}
+
+int32_t motion_steps_to_deg10(Axis_Id axis, int32_t steps){
+    return steps_to_deg10_table[axis](steps);
+}
+
+int32_t motion_counts_to_deg10(Axis_Id axis, int32_t counts){
+    return counts_to_deg10_table[axis](counts);
+}
+
+q16_t motion_shape(Motion_Shape shape, q16_t t){
+    ShapeTable const& table = shape == MOTION_SHAPE_MIN_JERK ? min_jerk_table :
+                                                               sine_table;
+    if(t <= 0){
+        return 0;
+    }else if(t >= Q16_ONE){
+        return Q16_ONE;
+    }
+
+    // Q16 time to table index and interpolation fraction
+    int32_t position = t * MOTION_SHAPE_SAMPLES;
+    int32_t index = position / Q16_ONE;
+    int32_t fraction = position % Q16_ONE;
+    return table[index] + q16_mul(table[index + 1] - table[index], fraction);
+}
+
+q16_t motion_cos(q16_t turns){
+    constexpr int32_t quarter = Q16_ONE / 4;
+
+    // Fraction of turn, two's complement keeps negative angles right
+    int32_t phase = static_cast<int32_t>(static_cast<uint32_t>(turns) 
+                                         & (Q16_ONE - 1));
+    int32_t quadrant = phase / quarter;
+    int32_t offset = phase % quarter;
+    if(quadrant == 1 || quadrant == 3){
+        offset = quarter - offset;
+    }
+
+    int32_t position = offset * MOTION_COS_SAMPLES;
+    int32_t index = position / quarter;
+    int32_t fraction = (position % quarter) * 4;
+    q16_t value = index == MOTION_COS_SAMPLES ? cos_table[index] :
+                  cos_table[index] + q16_mul(cos_table[index + 1] - cos_table[index],
+                                             fraction);
+    return (quadrant == 1 || quadrant == 2) ? -value : value;
+}
@@ -0,0 +1,54 @@
+/**
+  ******************************************************************************
+  * @file    motors_snapshot.c
+  * @author  Camilo Vera
+  * @brief   Motors state snapshot
+  *          Position, velocity and state published by the Motors AO in a
+  *          double buffer. Any AO reads it without events or blocking the
+  *          writer.
+  ******************************************************************************
+*/
+
+#include "motors_snapshot.h"
+
+/* Includes ------------------------------------------------------------------*/
+
+// Standard C libraries
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+// SDK Libraries
+#include "hardware/sync.h"
+
+void Motors_snapshot_write(Motors_Snapshot* snapshot,
+                           Motors_Snapshot_Data const* data){
+    Motors_Snapshot_Buffer* buffer = &snapshot->buffers[snapshot->active ^ 1U];
+
+    buffer->sequence++;
+    __dmb();                            // Odd sequence visible before data
+    memcpy(&buffer->data, data, sizeof(buffer->data));
+    __dmb();                            // Data visible before even sequence
+    buffer->sequence++;
+    __dmb();                            // Buffer complete before the flip
+    snapshot->active ^= 1U;
+}
+
+bool Motors_snapshot_read(Motors_Snapshot const* snapshot,
+                          Motors_Snapshot_Data* data){
+    Motors_Snapshot_Data copy;
+
+    for(uint8_t try = 0; try < MOTORS_SNAPSHOT_READ_TRIES; try++){
+        Motors_Snapshot_Buffer const* buffer =
+            &snapshot->buffers[snapshot->active];
+        uint32_t start = buffer->sequence;
+        __dmb();
+        memcpy(&copy, &buffer->data, sizeof(copy));
+        __dmb();
+        if(!(start & 1U) && start == buffer->sequence){
+            memcpy(data, &copy, sizeof(*data));
+            return true;
+        }
+    }
+    return false;
+}
@@ -15,6 +15,7 @@
 #include <stdio.h>
 #include <stdint.h>
 #include <stdbool.h>
+#include <string.h>
 
 
 // SDK Libraries
@@ -33,6 +34,7 @@
 // Project libraries
 #include "bsp.h"
 #include "dev_hd44780.h"
+#include "lcd_bar.h"
 
 /* Implementation ------------------------------------------------------------*/
 
@@ -53,14 +55,37 @@ void Printer_ctor(Printer * const this){
 
     //stdio_init_all();
 
-    i2c_init(i2c0, 100 * 1000);
+    i2c_init(LCD_I2C, LCD_I2C_BAUDRATE);
     gpio_set_function(LCD_SDA_PIN, GPIO_FUNC_I2C);
     gpio_set_function(LCD_SCL_PIN, GPIO_FUNC_I2C);
     gpio_pull_up(LCD_SDA_PIN);
     gpio_pull_up(LCD_SCL_PIN);
 
-    dev_hd44780_init(i2c0, 0x27);
+    // Busy flag polling, falls back to timed writes without R/W wired
+    dev_hd44780_set_mode(HD44780_MODE_BUSY);
+    dev_hd44780_init(LCD_I2C, LCD_ADDR);
+    if(dev_hd44780_get_mode() != HD44780_MODE_BUSY){
+        printf("LCD: no busy flag, using timed writes\n");
+    }
+    // Bar glyphs are written once, bars are then plain characters
+    for(uint8_t g = 0; g < LCD_BAR_GLYPHS; g++){
+        dev_hd44780_cgram(LCD_I2C, LCD_ADDR, LCD_BAR_FIRST_GLYPH + g,
+                          lcd_bar_glyphs[g]);
+    }
+#if PRINTER_LCD_BENCHMARK
+    Printer_benchmark();
+#endif
+    Lcd_frame_init(&this->frame);
+    memset(&this->mailbox, 0, sizeof(this->mailbox));
+    this->frame_armed = false;
 
+    // From here on the display is only written by DMA
+    this->stream_len = 0;
+    Lcd_dma_init(&this->lcd, LCD_I2C, LCD_ADDR, &lcd_transfer_done,
+                 &this->super);
+#if PRINTER_LCD_BENCHMARK
+    Printer_benchmark_dma(this);
+#endif
 }
 
 /* AO Class execution callback -----------------------------------------------*/
@@ -76,33 +101,33 @@ static void Printer_dispatch(Printer * const this,
                                   Event const * const e){
     switch (e->sig) {
         case INIT_SIG:      // This event is always executed at the beginning.
-            // Clear screen
-            dev_hd44780_text(i2c0, 0x27, 0, true, "                    ");
-            dev_hd44780_text(i2c0, 0x27, 1, true, "                    ");
-            dev_hd44780_text(i2c0, 0x27, 2, true, "                    ");
-            dev_hd44780_text(i2c0, 0x27, 3, true, "                    ");
+            // Clear screen, already blank after dev_hd44780_init()
+            for(uint8_t row = 0; row < LCD_ROWS; row++){
+                Lcd_frame_set_row(&this->frame, row, "                    ");
+            }
+            Printer_render(this);
             break;
 
-        case PRINTER_AO_TEXT0_SIG:{
-            dev_hd44780_text(i2c0, 0x27, 0, true,
-                             ((PRINTER_AO_TEXT_PL*)e)->string_buffer);
-            break;
-        }
-        case PRINTER_AO_TEXT1_SIG:{
-            dev_hd44780_text(i2c0, 0x27, 1, true,
-                             ((PRINTER_AO_TEXT_PL*)e)->string_buffer);
+        case PRINTER_AO_TIMEOUT_SIG:{
+            // Frame slot over, rows changed during it are drawn now
+            this->frame_armed = false;
+            Printer_render(this);
             break;
         }
 
-        case PRINTER_AO_TEXT2_SIG:{
-            dev_hd44780_text(i2c0, 0x27, 2, true,
-                             ((PRINTER_AO_TEXT_PL*)e)->string_buffer);
+        case PRINTER_AO_UPDATE_SIG:{
+            Printer_take_mailbox(this);
+            Printer_render(this);
             break;
         }
 
-        case PRINTER_AO_TEXT3_SIG:{
-            dev_hd44780_text(i2c0, 0x27, 3, true,
-                             ((PRINTER_AO_TEXT_PL*)e)->string_buffer);
+        case PRINTER_AO_LCD_DONE_SIG:{
+            if(!((PRINTER_AO_LCD_DONE_PL*)e)->ok){
+                // Unknown what reached the display, rewrite all of it
+                printf("LCD: transfer aborted\n");
+                Lcd_frame_invalidate(&this->frame);
+            }
+            Printer_render(this);
             break;
         }
 
@@ -112,4 +137,216 @@ static void Printer_dispatch(Printer * const this,
     }
 }
 
+/**
+ * @brief Draw the pending rows unless a frame was drawn less than 
+ * PRINTER_FRAME_MS ago, then the frame timer draws them when it expires.
+ * Bus load is bounded by the frame rate whatever the rate of updates.
+ */
+static void Printer_render(Printer * const this){
+    if(this->frame_armed || !Lcd_frame_pending(&this->frame)){
+        return;
+    }
+    // Also armed if the transport is busy, to retry on the next frame
+    Printer_flush(this);
+    TimeEvent_arm(&this->te, (PRINTER_FRAME_MS / portTICK_RATE_MS), 0U);
+    this->frame_armed = true;
+}
+
+/**
+ * @brief Send the pending rows as one DMA transfer. While a transfer runs the
+ * rows stay dirty and are sent in a later frame, coalescing their updates.
+ */
+static void Printer_flush(Printer * const this){
+    uint32_t aborts = this->lcd.aborts;
+
+    if(!Lcd_frame_pending(&this->frame) || !Lcd_dma_ready(&this->lcd)){
+        return;
+    }
+    if(this->lcd.aborts != aborts){
+        printf("LCD: transfer timed out\n");
+        Lcd_frame_invalidate(&this->frame);
+    }
+
+    this->stream_len = 0;
+    Lcd_frame_flush(&this->frame, &Printer_write, this);
+    Lcd_dma_send(&this->lcd, this->stream, this->stream_len);
+
+#if PRINTER_LCD_STATS
+    if(this->frame.flushes % PRINTER_STATS_FLUSHES == 0){
+        printf("LCD: %lu flushes, %lu bytes sent, %lu bytes saved, "
+               "%lu us last transfer, %lu us max, %lu/%lu rows coalesced\n",
+               this->frame.flushes, this->frame.bytes_sent,
+               this->frame.bytes_saved, this->lcd.last_us, this->lcd.max_us,
+               this->mailbox.coalesced, this->mailbox.posts);
+    }
+#endif
+}
+
+/* AO Class public methods ---------------------------------------------------*/
+void Printer_post_row(Active * const printer, uint8_t row, char const* text){
+    Printer* this = (Printer*)printer;
+    bool notify;
+
+    if(row >= LCD_ROWS){
+        return;
+    }
+    taskENTER_CRITICAL();
+    notify = mailbox_put(&this->mailbox, row, text);
+    taskEXIT_CRITICAL();
+    mailbox_notify(this, notify);
+}
+
+void Printer_post_frame(Active * const printer, 
+                        char const* const rows[LCD_ROWS]){
+    Printer* this = (Printer*)printer;
+    bool notify = false;
+
+    taskENTER_CRITICAL();
+    for(uint8_t row = 0; row < LCD_ROWS; row++){
+        if(rows[row] != NULL){
+            notify |= mailbox_put(&this->mailbox, row, rows[row]);
+        }
+    }
+    taskEXIT_CRITICAL();
+    mailbox_notify(this, notify);
+}
+
+// Moves the posted rows to the frame, posters may queue a new update after it
+static void Printer_take_mailbox(Printer * const this){
+    taskENTER_CRITICAL();
+    for(uint8_t row = 0; row < LCD_ROWS; row++){
+        if(this->mailbox.pending & (1U << row)){
+            Lcd_frame_set_row(&this->frame, row, this->mailbox.rows[row]);
+        }
+    }
+    this->mailbox.pending = 0;
+    this->mailbox.posted = false;
+    taskEXIT_CRITICAL();
+}
+
+// Overlays text on the row, as Lcd_frame_set_row() would do on the display.
+// Critical section, returns true if the update event must be posted.
+static bool mailbox_put(Printer_Mailbox* mailbox, uint8_t row, 
+                        char const* text){
+    char* pending = mailbox->rows[row];
+    uint8_t len = 0;
+    uint8_t col;
+
+    if(mailbox->pending & (1U << row)){
+        len = strlen(pending);
+        mailbox->coalesced++;
+    }
+    for(col = 0; col < LCD_COLS && text[col] != '\0'; col++){
+        pending[col] = text[col];
+    }
+    if(col >= len){
+        pending[col] = '\0';
+    }
+    mailbox->pending |= 1U << row;
+    mailbox->posts++;
+
+    bool notify = !mailbox->posted;
+    mailbox->posted = true;
+    return notify;
+}
+
+static void mailbox_notify(Printer * const this, bool notify){
+    static Event const update_event = {PRINTER_AO_UPDATE_SIG};
+
+    if(notify){
+        Active_post(&this->super, &update_event);
+    }
+}
+
+// Appends a run of characters to the stream
+static void Printer_write(void* context, uint8_t row, uint8_t col,
+                          uint8_t const* data, uint8_t len){
+    Printer* this = (Printer*)context;
+    this->stream_len += dev_hd44780_pack_at(&this->stream[this->stream_len],
+                                            row, true, col, data, len);
+}
+
+// I2C interrupt context
+static void lcd_transfer_done(void* context, bool ok){
+    static PRINTER_AO_LCD_DONE_PL lcd_done_event;
+    BaseType_t xHigherPriorityTaskWoken = pdFALSE;
+
+    lcd_done_event.super.sig = PRINTER_AO_LCD_DONE_SIG;
+    lcd_done_event.ok = ok;
+    Active_postFromISR((Active*)context, &lcd_done_event.super,
+                       &xHigherPriorityTaskWoken);
+    portYIELD_FROM_ISR(xHigherPriorityTaskWoken);
+}
+
+#if PRINTER_LCD_BENCHMARK
+/**
+ * @brief Write full rows with every blocking transfer mode and print the 
+ * achieved characters per second, leaves the display blank. At run time
+ * these modes only serve init and the CGRAM glyphs.
+ */
+static void Printer_benchmark(void){
+    static const char* const mode_names[] = {"timed", "packed", "busy flag"};
+    static const dev_hd44780_mode_t modes[] = {HD44780_MODE_TIMED,
+                                               HD44780_MODE_PACKED,
+                                               HD44780_MODE_BUSY};
+    bool busy_flag = dev_hd44780_get_mode() == HD44780_MODE_BUSY;
+
+    for(uint8_t m = 0; m < sizeof(modes)/sizeof(modes[0]); m++){
+        if(modes[m] == HD44780_MODE_BUSY && !busy_flag){
+            continue;
+        }
+        dev_hd44780_set_mode(modes[m]);
+        uint64_t start_us = time_us_64();
+        for(uint8_t n = 0; n < PRINTER_BENCHMARK_ROWS; n++){
+            dev_hd44780_write_at(LCD_I2C, LCD_ADDR, n % LCD_ROWS, true, 0,
+                                 (uint8_t const*)"0123456789ABCDEFGHIJ", LCD_COLS);
+        }
+        uint32_t elapsed_us = (uint32_t)(time_us_64() - start_us);
+        printf("LCD %s: %lu chars/s\n", mode_names[m], 
+               (uint32_t)((uint64_t)PRINTER_BENCHMARK_ROWS*LCD_COLS*1000000 
+                          / elapsed_us));
+    }
+    dev_hd44780_set_mode(HD44780_MODE_PACKED);
+    for(uint8_t row = 0; row < LCD_ROWS; row++){
+        dev_hd44780_write_at(LCD_I2C, LCD_ADDR, row, true, 0,
+                             (uint8_t const*)"                    ", LCD_COLS);
+    }
+}
+
+/**
+ * @brief Send whole 4x20 frames through the DMA path that draws every frame
+ * at run time and print the achieved characters per second. Runs before the
+ * scheduler, so completions are polled instead of posted.
+ */
+static void Printer_benchmark_dma(Printer * const this){
+    Lcd_Dma_Callback callback = this->lcd.callback;
+
+    this->lcd.callback = NULL;
+    uint64_t start_us = time_us_64();
+    for(uint8_t n = 0; n < PRINTER_BENCHMARK_FRAMES; n++){
+        this->stream_len = 0;
+        for(uint8_t row = 0; row < LCD_ROWS; row++){
+            Printer_write(this, row, 0, (uint8_t const*)"0123456789ABCDEFGHIJ",
+                          LCD_COLS);
+        }
+        while(!Lcd_dma_send(&this->lcd, this->stream, this->stream_len)){
+            tight_loop_contents();
+        }
+    }
+    while(!Lcd_dma_ready(&this->lcd)){
+        tight_loop_contents();
+    }
+    uint32_t elapsed_us = (uint32_t)(time_us_64() - start_us);
+    printf("LCD DMA: %lu chars/s, %lu us per frame, %lu aborts\n",
+           (uint32_t)((uint64_t)PRINTER_BENCHMARK_FRAMES*LCD_ROWS*LCD_COLS*1000000
+                      / elapsed_us),
+           elapsed_us / PRINTER_BENCHMARK_FRAMES, this->lcd.aborts);
+
+    // The glass no longer matches the frame, INIT_SIG redraws all of it
+    this->lcd.callback = callback;
+    this->stream_len = 0;
+    Lcd_frame_invalidate(&this->frame);
+}
+#endif
+
 /************************ Camilo Vera **************************END OF FILE****/
\ No newline at end of file
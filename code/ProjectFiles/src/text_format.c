@@ -0,0 +1,78 @@
+/**
+  ******************************************************************************
+  * @file    text_format.c
+  * @author  Camilo Vera
+  * @brief   Text formatting
+  *          Integer and tenth of degree formatting written straight into the
+  *          20 character rows of the display, without sprintf or allocation.
+  ******************************************************************************
+*/
+
+#include "text_format.h"
+
+/* Includes ------------------------------------------------------------------*/
+
+// Standard C libraries
+#include <stdint.h>
+#include <stdbool.h>
+
+uint8_t Text_format_int(char* buffer, int32_t value){
+    char digits[10];
+    uint8_t count = 0;
+    uint8_t len = 0;
+
+    // Magnitude as unsigned, INT32_MIN has no positive counterpart
+    uint32_t magnitude = (uint32_t)value;
+    if(value < 0){
+        buffer[len++] = '-';
+        magnitude = 0U - magnitude;
+    }
+    do{
+        digits[count++] = '0' + magnitude % 10;
+        magnitude /= 10;
+    }while(magnitude != 0);
+
+    while(count > 0){
+        buffer[len++] = digits[--count];
+    }
+    buffer[len] = '\0';
+    return len;
+}
+
+uint8_t Text_format_deg10(char* buffer, int32_t deg10){
+    uint32_t magnitude = deg10 < 0 ? 0U - (uint32_t)deg10 : (uint32_t)deg10;
+    uint8_t len = 0;
+
+    // -0.5 has no integer part to carry the sign
+    if(deg10 < 0){
+        buffer[len++] = '-';
+    }
+    len += Text_format_int(&buffer[len], (int32_t)(magnitude / 10));
+    buffer[len++] = '.';
+    buffer[len++] = '0' + magnitude % 10;
+    buffer[len] = '\0';
+    return len;
+}
+
+void Text_put(char* row, uint8_t col, char const* text){
+    while(col < TEXT_ROW_LEN && *text != '\0'){
+        row[col++] = *text++;
+    }
+    while(col < TEXT_ROW_LEN){
+        row[col++] = ' ';
+    }
+}
+
+void Text_put_int(char* row, uint8_t col, int32_t value){
+    char buffer[TEXT_INT_MAX];
+
+    Text_format_int(buffer, value);
+    Text_put(row, col, buffer);
+}
+
+void Text_put_deg10(char* row, uint8_t col, int32_t deg10){
+    char buffer[TEXT_INT_MAX + 1];
+
+    Text_format_deg10(buffer, deg10);
+    Text_put(row, col, buffer);
+}
@@ -0,0 +1,181 @@
+/**
+  ******************************************************************************
+  * @file    ui_script.c
+  * @author  Camilo Vera
+  * @brief   Scripted UI runner
+  *          Feeds the UI AO a script of button presses and motor answers,
+  *          checks the screen left in the printer mailbox and measures the
+  *          dispatch time. Runs before the scheduler starts, with the UI
+  *          timers expired in virtual time, so no buttons or display are
+  *          needed.
+  ******************************************************************************
+*/
+
+#include "ui_script.h"
+
+/* Includes ------------------------------------------------------------------*/
+
+// Standard C libraries
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+// SDK Libraries
+#include "pico/stdlib.h"
+
+// FreeRTOS
+#include <FreeRTOS.h>
+#include <queue.h>
+
+// FreeAct
+#include <FreeAct.h>
+
+// Project libraries
+#include "UI_AO.h"
+#include "printer_AO.h"
+#include "motion_plan.h"
+
+const UI_Script_Step ui_script_default[] = {
+    // Boot without a stored calibration
+    UI_SCRIPT_PRESS(INIT_SIG, 1),
+    UI_SCRIPT_SCREEN(1, "    Calibrating...  "),
+    UI_SCRIPT_PRESS(UI_AO_ACK_CALIB_SIG, 1),
+    UI_SCRIPT_SCREEN(0, " Choose an option:  "),
+    UI_SCRIPT_SCREEN(2, "*Create Routine     "),
+    UI_SCRIPT_PRESS(UI_AO_SW3_PRESSED_SIG, 1),
+    UI_SCRIPT_SCREEN(3, "*Do default routine "),
+    UI_SCRIPT_PRESS(UI_AO_SW2_PRESSED_SIG, 1),
+    UI_SCRIPT_SCREEN(2, "*Create Routine     "),
+
+    // Menu scrolling, past both ends
+    UI_SCRIPT_PRESS(UI_AO_SW4_PRESSED_SIG, 1),
+    UI_SCRIPT_SCREEN(0, " Add exercise       "),
+    UI_SCRIPT_PRESS(UI_AO_SW3_PRESSED_SIG, 50),
+    UI_SCRIPT_SCREEN(3, "*Begin Routine      "),
+    UI_SCRIPT_PRESS(UI_AO_SW2_PRESSED_SIG, 50),
+    UI_SCRIPT_SCREEN(2, "*PronoSupination    "),
+
+    // One FlexoExtension exercise of 3 repetitions
+    UI_SCRIPT_PRESS(UI_AO_SW3_PRESSED_SIG, 1),
+    UI_SCRIPT_PRESS(UI_AO_SW4_PRESSED_SIG, 1),
+    UI_SCRIPT_SCREEN(0, "Config. FlexoExt.   "),
+    UI_SCRIPT_PRESS(UI_AO_SW4_PRESSED_SIG, 1),
+    UI_SCRIPT_SCREEN(1, "    repetitions:    "),
+    UI_SCRIPT_PRESS(UI_AO_SW3_PRESSED_SIG, 2),
+    UI_SCRIPT_SCREEN(3, "3                   "),
+    UI_SCRIPT_PRESS(UI_AO_SW4_PRESSED_SIG, 1),
+    UI_SCRIPT_SCREEN(2, "*Repetitions: 3     "),
+    UI_SCRIPT_PRESS(UI_AO_SW3_PRESSED_SIG, 5),
+    UI_SCRIPT_PRESS(UI_AO_SW4_PRESSED_SIG, 1),
+    UI_SCRIPT_SCREEN(0, " Add exercise       "),
+
+    // Run it
+    UI_SCRIPT_PRESS(UI_AO_SW3_PRESSED_SIG, 5),
+    UI_SCRIPT_PRESS(UI_AO_SW4_PRESSED_SIG, 1),
+    UI_SCRIPT_SCREEN(0, " Created routine    "),
+    UI_SCRIPT_PRESS(UI_AO_SW3_PRESSED_SIG, 1),
+    UI_SCRIPT_PRESS(UI_AO_SW4_PRESSED_SIG, 1),
+    UI_SCRIPT_SCREEN(3, "If ready press enter"),
+    UI_SCRIPT_PRESS(UI_AO_SW4_PRESSED_SIG, 1),
+    UI_SCRIPT_PLAN(MOTION_PLAN_TO_MIN, 0, -200),
+    UI_SCRIPT_SCREEN(1, "Min. Angle          "),
+    UI_SCRIPT_SCREEN(2, "Current rep.: 1     "),
+    UI_SCRIPT_PLAN(MOTION_PLAN_HOLD_MIN, 0, 3000),
+    UI_SCRIPT_SCREEN(3, "Hold 1"),
+    UI_SCRIPT_PLAN(MOTION_PLAN_TO_MAX, 2, 200),
+    UI_SCRIPT_SCREEN(1, "Max. Angle          "),
+    UI_SCRIPT_SCREEN(2, "Current rep.: 3     "),
+    UI_SCRIPT_PLAN(MOTION_PLAN_FINISHED, 2, 0),
+    UI_SCRIPT_SCREEN(0, " Choose an option:  "),
+    UI_SCRIPT_DONE
+};
+
+static void script_dispatch(UI * const ui, Event const * const e,
+                            UI_Script_Result* result){
+    uint32_t start_us = time_us_32();
+    (*ui->super.dispatch)(&ui->super, e);
+    uint32_t elapsed_us = time_us_32() - start_us;
+
+    result->events++;
+    result->total_us += elapsed_us;
+    if(elapsed_us > result->max_us){
+        result->max_us = elapsed_us;
+        result->max_sig = e->sig;
+    }
+}
+
+// Deliver what the UI posted to itself and its timer, expired at once
+static void script_settle(UI * const ui, UI_Script_Result* result){
+    for(uint8_t n = 0; n < UI_SCRIPT_TIMEOUTS; n++){
+        Event const* e;
+        while(xQueueReceive(ui->super.queue, &e, 0) == pdTRUE){
+            script_dispatch(ui, e, result);
+        }
+        if(ui->te.timeout == 0U){
+            break;
+        }
+        TimeEvent_disarm(&ui->te);
+        script_dispatch(ui, &ui->te.super, result);
+    }
+
+    // Motor commands have no reader
+    xQueueReset(AO_Motors->queue);
+}
+
+bool UI_script_run(UI * const ui, Printer const * const printer,
+                   UI_Script_Step const* script, UI_Script_Result* result){
+    static UI_AO_PLAN_PROGRESS_PL progress_event;
+
+    memset(result, 0, sizeof(*result));
+
+    for(uint16_t s = 0; script[s].action != UI_SCRIPT_END; s++){
+        UI_Script_Step const* step = &script[s];
+
+        switch(step->action){
+            case UI_SCRIPT_POST:{
+                Event const event = {step->sig};
+                for(uint16_t n = 0; n < step->count; n++){
+                    script_dispatch(ui, &event, result);
+                    script_settle(ui, result);
+                }
+            break;
+            }
+            case UI_SCRIPT_PROGRESS:{
+                progress_event.super.sig = UI_AO_PLAN_PROGRESS_SIG;
+                progress_event.phase = step->row;
+                progress_event.exercise = 0;
+                progress_event.rep = step->count;
+                progress_event.value = step->value;
+                script_dispatch(ui, &progress_event.super, result);
+                script_settle(ui, result);
+            break;
+            }
+            case UI_SCRIPT_EXPECT:{
+                // Rows are left in the mailbox, the printer isn't running
+                char const* row = printer->mailbox.rows[step->row];
+                result->checks++;
+                if(strncmp(row, step->text, strlen(step->text)) != 0){
+                    printf("UI script step %u: row %u is \"%s\", "
+                           "expected \"%s\"\n", s, step->row, row, step->text);
+                    result->failures++;
+                }
+            break;
+            }
+            default:
+                break;
+        }
+    }
+    return result->failures == 0;
+}
+
+void UI_script_report(UI_Script_Result const* result){
+    uint32_t total_us = result->total_us > 0 ? result->total_us : 1;
+
+    printf("UI script: %u/%u checks passed\n",
+           result->checks - result->failures, result->checks);
+    printf("UI script: %lu events, %lu events/s, %lu us max (signal %u)\n",
+           result->events,
+           (uint32_t)((uint64_t)result->events * 1000000 / total_us),
+           result->max_us, result->max_sig);
+}
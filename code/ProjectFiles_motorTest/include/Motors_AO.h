@@ -63,16 +63,17 @@ extern Active *AO_blinkyButton;
 #define MOTOR2_CALIB_FREQ 250
 #define MOTOR2_CALIB_STEPS 1
 
-#define MOTOR1_CENTER_FREQ 50
+// Step by step moves are paced by the 10 ms timer, the steps must fit in it
+#define MOTOR1_CENTER_FREQ 400
 #define MOTOR1_CENTER_STEPS 2
 
-#define MOTOR2_CENTER_FREQ 50
+#define MOTOR2_CENTER_FREQ 400
 #define MOTOR2_CENTER_STEPS 2
 
-#define MOTOR1_MOVEMENT_FREQ 50
+#define MOTOR1_MOVEMENT_FREQ 400
 #define MOTOR1_MOVEMENT_STEPS 2
 
-#define MOTOR2_MOVEMENT_FREQ 50
+#define MOTOR2_MOVEMENT_FREQ 400
 #define MOTOR2_MOVEMENT_STEPS 2
 
 
@@ -22,9 +22,12 @@
 
 
 
+#define STEPPER_CYCLES_PER_STEP(delay) (2*(delay) + 7)   // See stepper.pio
+
 typedef struct{
     PIO pio;
     uint8_t sm;
+    uint8_t program_offset;
     uint32_t dir_pin;
     uint32_t step_pin;
     uint32_t enable_pin;
@@ -56,5 +59,9 @@ void StepperMotor_move(StepperMotor* this,
                        uint8_t dir, 
                        uint32_t _steps_frequency,
                        uint16_t _steps_pending);
+
+void StepperMotor_stop(StepperMotor* this);
+
+bool StepperMotor_is_moving(StepperMotor* this);
 #endif /* PIO_STEPPER_H */
 /************************ Camilo Vera **************************END OF FILE****/
@@ -55,14 +55,25 @@ void StepperMotor_ctor(StepperMotor* this,
     gpio_put(this->dir_pin, true);
     gpio_put(this->enable_pin, false);
 
-    uint offset = pio_add_program(this->pio, &stepper_program);
-    float div = (float)clock_get_hz(clk_sys) / (this->steps_frequency*4); 
-    pio_stepper_init(this->pio, this->sm,offset,this->step_pin, div);
+    // The step rate is set by the delay sent with every move, so the state
+    // machine runs at full speed
+    this->program_offset = pio_add_program(this->pio, &stepper_program);
+    pio_stepper_init(this->pio, this->sm, this->program_offset,
+                     this->step_pin, 1);
     pio_sm_set_enabled(this->pio, this->sm, true);
 
 }
 
 
+// Half period delay loops for a step frequency
+static uint32_t StepperMotor_step_delay(uint32_t steps_frequency){
+    uint32_t cycles = clock_get_hz(clk_sys) / steps_frequency;
+    if(cycles <= STEPPER_CYCLES_PER_STEP(0)){
+        return 0;
+    }
+    return (cycles - STEPPER_CYCLES_PER_STEP(0)) / 2;
+}
+
 void StepperMotor_disable(StepperMotor* this){
     gpio_put(this->enable_pin, true);
 }
@@ -79,15 +90,42 @@ void StepperMotor_move(StepperMotor* this,
                        uint16_t _steps_pending){
 
 
+    if(_steps_pending == 0 || _steps_frequency == 0){
+        return;
+    }
+
     this->steps_frequency = _steps_frequency;
     this->steps_pending = _steps_pending;
     this->current_direction = dir;
 
     gpio_put(this->dir_pin, dir);
-    float div = (float)clock_get_hz(clk_sys) / (this->steps_frequency*4);
-    pio_sm_set_clkdiv(this->pio,this->sm,div);
     
     StepperMotor_enable(this);
     pio_sm_put(this->pio, this->sm, this->steps_pending-1);
+    pio_sm_put(this->pio, this->sm, 
+               StepperMotor_step_delay(this->steps_frequency));
+}
+
+/**
+ * @brief Abort the current move, steps not yet executed are discarded
+ */
+void StepperMotor_stop(StepperMotor* this){
+    pio_sm_set_enabled(this->pio, this->sm, false);
+    pio_sm_clear_fifos(this->pio, this->sm);
+    pio_sm_restart(this->pio, this->sm);
+    pio_sm_exec(this->pio, this->sm, pio_encode_set(pio_pins, 0));
+    pio_sm_exec(this->pio, this->sm, pio_encode_jmp(this->program_offset));
+    pio_sm_set_enabled(this->pio, this->sm, true);
+
+    this->steps_pending = 0;
+}
+
+/**
+ * @brief The state machine is idle when it is stalled on the first pull
+ * with nothing left in the FIFO
+ */
+bool StepperMotor_is_moving(StepperMotor* this){
+    return !pio_sm_is_tx_fifo_empty(this->pio, this->sm) ||
+           pio_sm_get_pc(this->pio, this->sm) != this->program_offset;
 }
 